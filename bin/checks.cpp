@@ -1,8 +1,11 @@
 #include <SUNphi.hpp>
 
 #include <array>
+#include <complex>
+#include <filesystem>
 #include <iostream>
 #include <sstream>
+#include <vector>
 
 using namespace std;
 using namespace SUNphi;
@@ -603,6 +606,1579 @@ void checkMPIallReduce()
   TEST_PASSED;
 }
 
+/// Check the work-stealing task scheduler
+///
+/// Sums the elements of a range, each one computed in an independent task
+void checkTaskScheduler()
+{
+  /// Scheduler used to run the tasks
+  TaskScheduler scheduler;
+  
+  /// Length of the range
+  const int64_t n=
+    10000;
+  
+  /// Result of the sum
+  std::atomic<int64_t> sum{0};
+  
+  scheduler.runTasks(int64_t{0},n,[&sum](const int threadId,const int64_t i)
+				  {
+				    sum+=
+				      i;
+				  });
+  
+  /// Expected result
+  const int64_t expSum=
+    n*(n-1)/2;
+  
+  if(sum!=expSum)
+    CRASH<<"Sum is "<<sum.load()<<" expected "<<expSum;
+  
+  TEST_PASSED;
+}
+
+/// Check that all scheduling policies of the loop split cover the range exactly once
+void checkLoopSplitScheduling()
+{
+  /// Beginning of the range
+  const int beg=
+    3;
+  
+  /// End of the range
+  const int end=
+    1003;
+  
+  /// Checks a given policy
+  auto check=
+    [beg,end](auto policy,
+	      const int& chunkSize)
+    {
+      /// Number of times each element has been visited
+      std::vector<std::atomic<int>> nVisits(end);
+      
+      threads.loopSplit<decltype(policy)::value>(beg,end,[&nVisits](const int& threadId,const int& i)
+						 {
+						   nVisits[i]++;
+						 },chunkSize);
+      
+      for(int i=0;i<end;i++)
+	if(nVisits[i]!=(i>=beg))
+	  CRASH<<"Element "<<i<<" visited "<<nVisits[i].load()<<" times with policy "<<(int)decltype(policy)::value<<" and chunk size "<<chunkSize;
+    };
+  
+  for(const int chunkSize : {0,1,7})
+    {
+      check(std::integral_constant<LoopScheduling,LoopScheduling::STATIC>{},chunkSize);
+      check(std::integral_constant<LoopScheduling,LoopScheduling::DYNAMIC>{},chunkSize);
+      check(std::integral_constant<LoopScheduling,LoopScheduling::GUIDED>{},chunkSize);
+    }
+  
+  TEST_PASSED;
+}
+
+/// Check the reduction of a loop split among threads and ranks
+void checkLoopSplitReduce()
+{
+  /// Length of the range
+  const int64_t n=
+    10000;
+  
+  /// Sum of the elements on all ranks
+  const int64_t sum=
+    mpi.loopSplitAllReduce(int64_t{0},n,int64_t{0},[](const int& threadId,const int64_t& i)
+						 {
+						   return
+						     i;
+						 },7);
+  
+  /// Expected result
+  const int64_t expSum=
+    n*(n-1)/2*mpi.nRanks();
+  
+  if(sum!=expSum)
+    CRASH<<"Sum is "<<sum<<" expected "<<expSum;
+  
+  /// Maximum of the elements, computed with a custom combiner
+  const int64_t max=
+    threads.loopSplitReduce<LoopScheduling::DYNAMIC>(int64_t{0},n,int64_t{-1},[](const int& threadId,const int64_t& i)
+									      {
+										return
+										  (i*7919)%n;
+									      },
+						     [](const int64_t& a,const int64_t& b)
+						     {
+						       return
+							 std::max(a,b);
+						     },16);
+  
+  if(max!=n-1)
+    CRASH<<"Max is "<<max<<" expected "<<n-1;
+  
+  TEST_PASSED;
+}
+
+/// Check the parsing of the list of cores used to pin the threads
+void checkParseCoreList()
+{
+  /// Parsed list
+  const Vector<int> cores=
+    parseCoreList("0-3,8,10-11\n");
+  
+  /// Expected list
+  const Vector<int> expCores=
+    {0,1,2,3,8,10,11};
+  
+  if(cores!=expCores)
+    CRASH<<"Parsed "<<cores.size()<<" cores instead of "<<expCores.size();
+  
+  TEST_PASSED;
+}
+
+/// Check that the thread id is consistent after resizing the pool
+void checkThreadIdAfterResize()
+{
+  /// Original number of threads
+  const int nOrigThreads=
+    threads.nActiveThreads();
+  
+  for(const int nThreads : {2,nOrigThreads})
+    {
+      threads.resize(nThreads);
+      
+      /// Number of threads whose id matches the one passed to the work
+      std::atomic<int> nMatching{0};
+      
+      threads.workOn([&nMatching](const int& threadId)
+		     {
+		       if(threads.getThreadId()==threadId)
+			 nMatching++;
+		     });
+      
+      if(nMatching!=threads.nActiveThreads())
+	CRASH<<"Only "<<nMatching.load()<<" threads out of "<<threads.nActiveThreads()<<" have the correct id";
+    }
+  
+  TEST_PASSED;
+}
+
+/// Check the barrier of a pool with several threads
+///
+/// At each region every thread writes its slot, and reads the slot of
+/// another thread written in the previous region, which must be
+/// visible after the barrier closing it
+void checkBarrier()
+{
+  /// Number of regions
+  const int nIters=
+    10000;
+  
+  /// Pool with an explicit number of threads, more than the cores to exercise also the sleeping path
+  ThreadPool pool(4,ThreadPinning::NONE);
+  
+  /// Number of threads, only one when threads are disabled
+  const int nThreads=
+    pool.nActiveThreads();
+  
+  /// Slots written by each thread, alternating between two arrays
+  std::vector<int> slots[2]{std::vector<int>(nThreads,-1),std::vector<int>(nThreads,-1)};
+  
+  /// Number of stale slots found by the threads
+  std::atomic<int> nStale{0};
+  
+  for(int iter=0;iter<nIters;iter++)
+    {
+      pool.workOn([&slots,&nStale,iter,nThreads](const int& threadId)
+		  {
+		    if(slots[(iter+1)%2][(threadId+1)%nThreads]!=iter-1)
+		      nStale++;
+		    
+		    slots[iter%2][threadId]=
+		      iter;
+		  });
+      
+      for(int threadId=0;threadId<nThreads;threadId++)
+	if(slots[iter%2][threadId]!=iter)
+	  CRASH<<"Slot of thread "<<threadId<<" is "<<slots[iter%2][threadId]<<" after region "<<iter;
+    }
+  
+  if(nStale!=0)
+    CRASH<<nStale.load()<<" stale slots read by the threads";
+  
+  TEST_PASSED;
+}
+
+/// Check the asynchronous work given to the pool
+///
+/// Each worker marks its id while the master keeps working
+void checkAsyncWork()
+{
+  /// Mask of the threads which executed the work
+  std::atomic<int> mask{0};
+  
+  /// Handle to the work
+  ThreadPool::AsyncWork handle=
+    threads.workOnAsync([&mask](const int threadId)
+			{
+			  mask|=
+			    1<<threadId;
+			});
+  
+  /// Work done by the master in the meanwhile
+  const int masterRes=
+    threads.getThreadId();
+  
+  handle.wait();
+  
+  /// Expected mask, with only the workers or only the master if there is none
+  const int expMask=
+    (threads.nActiveThreads()==1)?1:((1<<threads.nActiveThreads())-2);
+  
+  if(masterRes!=masterThreadId or mask!=expMask or not handle.isReady())
+    CRASH<<"Mask is "<<mask.load()<<" expected "<<expMask;
+  
+  TEST_PASSED;
+}
+
+/// Check the split of the pool in teams
+///
+/// The master alone increments a counter while the rest of the pool
+/// sums a range
+void checkThreadTeams()
+{
+  /// Number of threads in the pool
+  const int nThreads=
+    threads.nActiveThreads();
+  
+  if(nThreads<2)
+    {
+      runLog()<<"Skipping thread teams test, only one thread in the pool";
+      return;
+    }
+  
+  /// Teams, one with only the master and one with the other threads
+  ThreadTeams teams({1,nThreads-1});
+  
+  /// Counter incremented by the master
+  int masterCount=
+    0;
+  
+  /// Length of the range
+  const int64_t n=
+    10000;
+  
+  /// Sum computed by the second team
+  std::atomic<int64_t> sum{0};
+  
+  teams.workOn([&masterCount](ThreadTeam& team,const int& teamThreadId)
+	       {
+		 masterCount++;
+	       },
+	       [&sum,n](ThreadTeam& team,const int& teamThreadId)
+	       {
+		 team.loopSplit(int64_t{0},n,[&sum](const int& threadId,const int64_t& i)
+					     {
+					       sum+=
+						 i;
+					     },teamThreadId);
+	       });
+  
+  if(masterCount!=1 or sum!=n*(n-1)/2)
+    CRASH<<"Master count "<<masterCount<<" expected 1, sum "<<sum.load()<<" expected "<<n*(n-1)/2;
+  
+  TEST_PASSED;
+}
+
+/// Check the allocation in parallel and the release from another thread
+void checkMemoryCrossThreadRelease()
+{
+  /// Number of threads
+  const int nThreads=
+    threads.nActiveThreads();
+  
+  /// Number of elements allocated by each thread
+  const int nel=
+    1000;
+  
+  /// Memory allocated by each thread
+  Vector<int*> ptrs(nThreads);
+  
+  threads.workOn([&ptrs,nel](const int threadId)
+		 {
+		   ptrs[threadId]=
+		     memory.provideAligned<int>(nel,ALIGNMENT);
+		   
+		   for(int i=0;i<nel;i++)
+		     ptrs[threadId][i]=
+		       threadId;
+		 });
+  
+  /// Memory used before releasing
+  const size_t usedBefore=
+    memory.getUsedSize();
+  
+  for(int threadId=0;threadId<nThreads;threadId++)
+    {
+      for(int i=0;i<nel;i++)
+	if(ptrs[threadId][i]!=threadId)
+	  CRASH<<"Memory of thread "<<threadId<<" was overwritten";
+      
+      memory.release(ptrs[threadId]);
+    }
+  
+  if(memory.getUsedSize()>=usedBefore)
+    CRASH<<"Used memory "<<memory.getUsedSize()<<" not decreased after release, was "<<usedBefore;
+  
+  TEST_PASSED;
+}
+
+/// Check the copy of an array split among the threads
+void checkCopyInParallel()
+{
+  /// Number of elements, large enough to be split
+  const int nel=
+    1<<20;
+  
+  /// Source
+  double* src=
+    memory.provideAligned<double>(nel,ALIGNMENT);
+  
+  for(int i=0;i<nel;i++)
+    src[i]=
+      i;
+  
+  /// Destination
+  double* dst=
+    memory.provideAligned<double>(nel,ALIGNMENT);
+  
+  memory.firstTouchInParallel(dst,nel);
+  memory.copyInParallel(dst,src,nel);
+  
+  for(int i=0;i<nel;i++)
+    if(dst[i]!=i)
+      CRASH<<"Element "<<i<<" copied as "<<dst[i];
+  
+  memory.release(src);
+  memory.release(dst);
+  
+  TEST_PASSED;
+}
+
+/// Check that small fully static tensors keep the data inside the storage
+void checkInlineTensStor()
+{
+  /// Kind of a tensor small enough to be kept inline
+  using SmallTk=
+    TensKind<RwCol,CnCol,Compl>;
+  
+  static_assert(TensStor<SmallTk,double>::hasInlineStorage,"SU(3) matrix not stored inline");
+  
+  static_assert(not TensStor<TensKind<Spacetime,Compl>,double>::hasInlineStorage,"Dynamic tensor stored inline");
+  
+  static_assert(sizeof(TensStor<SmallTk,double>::View)<sizeof(double)*SmallTk::maxStaticIdx,"View containing the inline buffer");
+  
+  static_assert(std::is_same_v<TensStor<TensKind<Spacetime,Compl>,double>::View,TensStor<TensKind<Spacetime,Compl>,double>>,
+		"Dynamic tensor viewed through a different type");
+  
+  /// Memory used before creating the tensor
+  const size_t usedBefore=
+    memory.getUsedSize();
+  
+  Tens<SmallTk,double> t;
+  
+  if(memory.getUsedSize()!=usedBefore)
+    CRASH<<"Memory used changed from "<<usedBefore<<" to "<<memory.getUsedSize()<<" creating an inline tensor";
+  
+  for(int ic1=0;ic1<NCOL;ic1++)
+    for(int ic2=0;ic2<NCOL;ic2++)
+      for(int ri=0;ri<2;ri++)
+	t.eval(ic1,ic2,ri)=
+	  ri+2*(ic2+NCOL*ic1);
+  
+  /// Copy of the storage
+  const TensStor<SmallTk,double> copy(t.getStor());
+  
+  for(int i=0;i<copy.totSize;i++)
+    if(copy._v[i]!=i)
+      CRASH<<"Element "<<i<<" copied as "<<copy._v[i];
+  
+  /// View on the storage
+  Tens view(&t.getStor());
+  
+  static_assert(std::is_same_v<decltype(view),Tens<SmallTk,double,TensIdx,true>>,"Wrong type of the view");
+  
+  if(&view.eval(0,0,1)!=&t.eval(0,0,1))
+    CRASH<<"View not sharing the data";
+  
+  TEST_PASSED;
+}
+
+/// Check the storage mapping a file
+void checkMappedTensStor()
+{
+  /// Kind of the tensor
+  using Tk=
+    TensKind<Spacetime,Compl>;
+  
+  /// Volume
+  const int vol=
+    1000;
+  
+  /// Offset of the data inside the file
+  const size_t offset=
+    sizeof(double);
+  
+  /// Path of the file
+  const std::filesystem::path path=
+    std::filesystem::temp_directory_path()/"SUNphiCheckMappedTensStor.bin";
+  
+  /// Data written to the file, preceded by a header
+  Vector<double> data(1+2*vol);
+  for(int i=0;i<data.size();i++)
+    data[i]=
+      i-1;
+  
+  if(FILE* fout=fopen(path.c_str(),"w"))
+    {
+      fwrite(data.data(),sizeof(double),data.size(),fout);
+      fclose(fout);
+    }
+  else
+    CRASH<<"Unable to write "<<path;
+  
+  {
+    /// Storage mapping the file
+    TensStor<Tk,double> stor(DynSizes<1>{{vol}},path,FileMapping::COPY_ON_WRITE,offset);
+    stor.prefetch();
+    
+    /// Tensor over the storage
+    Tens<Tk,double> t(&stor);
+    
+    for(int iSite=0;iSite<vol;iSite++)
+      for(int ri=0;ri<2;ri++)
+	if(t.eval(iSite,ri)!=ri+2*iSite)
+	  CRASH<<"Site "<<iSite<<" component "<<ri<<" read as "<<t.eval(iSite,ri);
+    
+    t.eval(0,0)=
+      -2;
+  }
+  
+  /// Storage mapping again the file, read-only
+  const TensStor<Tk,double> stor(DynSizes<1>{{vol}},path,FileMapping::READ_ONLY,offset);
+  
+  if(stor.eval(0,0)!=0)
+    CRASH<<"Change propagated to the file in copy-on-write mode";
+  
+  std::filesystem::remove(path);
+  
+  TEST_PASSED;
+}
+
+/// Check that the cache does not exceed its maximal size
+void checkMemoryCacheEviction()
+{
+  memory.clearCache();
+  
+  /// Maximal size of the cache
+  const size_t maxCachedSize=
+    1<<16;
+  
+  memory.setMaxCachedSize(maxCachedSize);
+  
+  /// Number of evicted blocks before the test
+  const size_t nEvictedBefore=
+    memory.getNEvicted();
+  
+  /// Blocks of growing size
+  Vector<char*> ptrs;
+  for(int size=1024;size<=(1<<16);size*=2)
+    ptrs.push_back(memory.provideAligned<char>(size,ALIGNMENT));
+  
+  for(char* ptr : ptrs)
+    memory.release(ptr);
+  
+  if(memory.getCachedSize()>maxCachedSize)
+    CRASH<<"Cached size "<<memory.getCachedSize()<<" exceeds the maximum "<<maxCachedSize;
+  
+  if(memory.getNEvicted()==nEvictedBefore)
+    CRASH<<"No block evicted";
+  
+  memory.adviseUnneededCachedPages();
+  
+  /// Size given back before advising again
+  const size_t advisedBefore=
+    memory.getAdvisedUnneededSize();
+  
+  if(memory.adviseUnneededCachedPages()!=0 or memory.getAdvisedUnneededSize()!=advisedBefore)
+    CRASH<<"Pages of already advised blocks counted again";
+  
+  memory.setMaxCachedSize(std::numeric_limits<size_t>::max());
+  
+  TEST_PASSED;
+}
+
+/// Check that the cap of the cache is enforced also on blocks released by other threads
+///
+/// The master releases the blocks allocated by all threads, which
+/// evict them from their cache at the next allocation
+void checkMemoryCacheEvictionByOwner()
+{
+  memory.clearCache();
+  
+  /// Maximal size of the cache
+  const size_t maxCachedSize=
+    1<<16;
+  
+  memory.setMaxCachedSize(maxCachedSize);
+  
+  /// Number of threads
+  const int nThreads=
+    threads.nActiveThreads();
+  
+  /// Number of blocks allocated by each thread
+  const int nBlocks=
+    8;
+  
+  /// Blocks allocated by each thread
+  Vector<char*> ptrs(nThreads*nBlocks);
+  
+  threads.workOn([&ptrs,nBlocks](const int threadId)
+		 {
+		   for(int iBlock=0;iBlock<nBlocks;iBlock++)
+		     ptrs[iBlock+nBlocks*threadId]=
+		       memory.provideAligned<char>(1<<14,ALIGNMENT);
+		 });
+  
+  for(char* ptr : ptrs)
+    memory.release(ptr);
+  
+  /// Size cached by each thread after a new allocation
+  Vector<size_t> threadCachedSize(nThreads);
+  
+  threads.workOn([&threadCachedSize](const int threadId)
+		 {
+		   memory.release(memory.provideAligned<char>(1<<10,ALIGNMENT));
+		   
+		   threadCachedSize[threadId]=
+		     memory.getThreadCachedSize();
+		 });
+  
+  for(int threadId=0;threadId<nThreads;threadId++)
+    if(threadCachedSize[threadId]>maxCachedSize)
+      CRASH<<"Cached size "<<threadCachedSize[threadId]<<" of thread "<<threadId<<" exceeds the maximum "<<maxCachedSize;
+  
+  if(memory.getCachedSize()>maxCachedSize*nThreads)
+    CRASH<<"Cached size "<<memory.getCachedSize()<<" exceeds the maximum "<<maxCachedSize<<" times "<<nThreads<<" threads";
+  
+  memory.setMaxCachedSize(std::numeric_limits<size_t>::max());
+  
+  TEST_PASSED;
+}
+
+/// Check that blocks above the huge pages threshold start at a huge page
+void checkMemoryHugePages()
+{
+  memory.clearCache();
+  
+  /// Threshold before the test
+  const size_t thresholdBefore=
+    memory.getHugePagesThreshold();
+  
+  memory.setHugePagesThreshold(1<<16);
+  
+  /// Number of allocations with huge pages before the test
+  const size_t nHugePagesAllocBefore=
+    memory.getNHugePagesAlloc();
+  
+  /// Size allocated with huge pages before the test
+  const size_t hugePagesSizeBefore=
+    memory.getHugePagesSize();
+  
+  /// Size of the huge page
+  const uintptr_t hugePageSize=
+    1<<21;
+  
+  /// Allocated memory
+  char* ptr=
+    memory.provideAligned<char>(1<<17,ALIGNMENT);
+  
+  if(reinterpret_cast<uintptr_t>(ptr)%hugePageSize)
+    CRASH<<"Data at "<<(void*)ptr<<" not aligned to the huge page";
+  
+  if(memory.getNHugePagesAlloc()!=nHugePagesAllocBefore+1)
+    CRASH<<"Allocations with huge pages went from "<<nHugePagesAllocBefore<<" to "<<memory.getNHugePagesAlloc();
+  
+  if(memory.getHugePagesSize()<hugePagesSizeBefore+(1<<17))
+    CRASH<<"Size allocated with huge pages went from "<<hugePagesSizeBefore<<" to "<<memory.getHugePagesSize();
+  
+  ptr[0]=ptr[(1<<17)-1]=
+    1;
+  
+  memory.release(ptr);
+  
+  memory.clearCache();
+  
+  if(memory.getHugePagesSize()!=hugePagesSizeBefore)
+    CRASH<<"Size allocated with huge pages is "<<memory.getHugePagesSize()<<" after release, expected "<<hugePagesSizeBefore;
+  
+  memory.setHugePagesThreshold(thresholdBefore);
+  
+  TEST_PASSED;
+}
+
+/// Check the accounting of the memory by tag
+void checkMemoryTags()
+{
+  /// Tag used for the test
+  Memory::Tag* tag=
+    memory.getTag("checkMemoryTags");
+  
+  if(memory.getTag("checkMemoryTags")!=tag)
+    CRASH<<"Tag created twice";
+  
+  /// Number of elements
+  const int nel=
+    1000;
+  
+  /// Allocated memory
+  double* ptr=
+    memory.provideAligned<double>(nel,ALIGNMENT,tag);
+  
+  if(tag->usedSize<sizeof(double)*nel or tag->nAlloc!=1)
+    CRASH<<"Tag accounts "<<(size_t)tag->usedSize<<" bytes in "<<tag->nAlloc<<" allocations";
+  
+  memory.release(ptr);
+  
+  if(tag->usedSize!=0 or tag->usedSize.extreme()<sizeof(double)*nel)
+    CRASH<<"Tag accounts "<<(size_t)tag->usedSize<<" bytes after release, maximal "<<tag->usedSize.extreme();
+  
+  memory.printUsageReport(runLog());
+  
+  TEST_PASSED;
+}
+
+/// Check that merged views share the storage and can outlive the tensor
+void checkMergedCompsViewSharesStorage()
+{
+  /// Kind of the tensor
+  using Tk=
+    TensKind<Spacetime,RwCol,Compl>;
+  
+  /// Volume
+  const int vol=
+    100;
+  
+  /// View of a tensor already destroyed
+  auto view=
+    [vol]()
+    {
+      /// Tensor to be viewed
+      Tens<Tk,double> t(vol);
+      
+      for(int iSite=0;iSite<vol;iSite++)
+	for(int iCol=0;iCol<NCOL;iCol++)
+	  for(int ri=0;ri<2;ri++)
+	    t.eval(iSite,iCol,ri)=
+	      ri+2*(iCol+NCOL*iSite);
+      
+      /// Memory used before creating the view
+      const size_t usedBefore=
+	memory.getUsedSize();
+      
+      /// Merged view
+      auto res=
+	t.getMaximallyMergedCompsView();
+      
+      if(memory.getUsedSize()!=usedBefore)
+	CRASH<<"Memory used changed from "<<usedBefore<<" to "<<memory.getUsedSize()<<" creating a view";
+      
+      if(t.getStor().nBufferRefs()!=2)
+	CRASH<<"Buffer shared by "<<t.getStor().nBufferRefs()<<" storages instead of 2";
+      
+      return
+	res;
+    }();
+  
+  if(view.getStor().nBufferRefs()!=1)
+    CRASH<<"Buffer shared by "<<view.getStor().nBufferRefs()<<" storages instead of 1";
+  
+  for(int i=0;i<vol*NCOL*2;i++)
+    if(view.eval(i)!=i)
+      CRASH<<"Element "<<i<<" of the view is "<<view.eval(i);
+  
+  /// Copy of the view, not sharing the storage
+  auto copy=
+    view;
+  
+  copy.eval(0)=
+    -1.0;
+  
+  if(view.eval(0)!=0.0 or copy.getStor().nBufferRefs()!=1)
+    CRASH<<"Copy shares the storage with the view";
+  
+  /// Kind of a tensor small enough to be kept inline
+  using InlineTk=
+    TensKind<RwCol,CnCol,Compl>;
+  
+  /// Tensor kept inline
+  Tens<InlineTk,double> s;
+  
+  /// Merged view of the tensor kept inline
+  auto inlineView=
+    s.getMaximallyMergedCompsView();
+  
+  for(int i=0;i<NCOL*NCOL*2;i++)
+    inlineView.eval(i)=
+      i;
+  
+  /// Copy of the tensor kept inline
+  Tens<InlineTk,double> inlineCopy(s);
+  
+  inlineCopy.eval(0,0,0)=
+    -1.0;
+  
+  for(int ic1=0;ic1<NCOL;ic1++)
+    for(int ic2=0;ic2<NCOL;ic2++)
+      for(int ri=0;ri<2;ri++)
+	if(s.eval(ic1,ic2,ri)!=ri+2*(ic2+NCOL*ic1))
+	  CRASH<<"Element "<<ic1<<" "<<ic2<<" "<<ri<<" of the tensor kept inline is "<<s.eval(ic1,ic2,ri);
+  
+  TEST_PASSED;
+}
+
+/// Check moving and cloning tensors
+void checkTensMoveAndClone()
+{
+  /// Kind of the tensor
+  using Tk=
+    TensKind<Spacetime,Compl>;
+  
+  /// Volume
+  const int vol=
+    100;
+  
+  /// Builds and returns a tensor
+  auto build=
+    [vol](const double& val)
+    {
+      /// Result
+      Tens<Tk,double> res(vol);
+      
+      for(int iSite=0;iSite<vol;iSite++)
+	for(int ri=0;ri<2;ri++)
+	  res.eval(iSite,ri)=
+	    val;
+      
+      return
+	res;
+    };
+  
+  /// Tensor built by a function
+  Tens<Tk,double> t=
+    build(1.0);
+  
+  /// Memory used before moving
+  const size_t usedBefore=
+    memory.getUsedSize();
+  
+  /// Moved tensor
+  Tens<Tk,double> moved(std::move(t));
+  
+  t=
+    build(2.0);
+  
+  if(memory.getUsedSize()!=2*usedBefore)
+    CRASH<<"Memory used "<<memory.getUsedSize()<<" instead of "<<2*usedBefore<<" after moving";
+  
+  /// Independent copy
+  Tens<Tk,double> cloned=
+    moved.clone();
+  
+  cloned.eval(0,0)=
+    3.0;
+  
+  if(moved.eval(0,0)!=1.0 or t.eval(0,0)!=2.0 or cloned.eval(1,1)!=1.0 or cloned.getStor().nBufferRefs()!=1)
+    CRASH<<"Moved: "<<moved.eval(0,0)<<", reassigned: "<<t.eval(0,0)<<", cloned: "<<cloned.eval(0,0)<<" "<<cloned.eval(1,1);
+  
+  /// Constant tensor to be copied
+  const Tens<Tk,double> constT=
+    build(4.0);
+  
+  /// Copy constructed tensor
+  Tens<Tk,double> copied(constT);
+  
+  /// Copy assigned tensor
+  Tens<Tk,double> assigned(vol);
+  
+  assigned=
+    constT;
+  
+  copied.eval(0,0)=
+    assigned.eval(0,1)=
+    5.0;
+  
+  if(constT.eval(0,0)!=4.0 or constT.eval(0,1)!=4.0 or copied.eval(1,0)!=4.0 or assigned.eval(1,0)!=4.0)
+    CRASH<<"Original: "<<constT.eval(0,0)<<" "<<constT.eval(0,1)<<", copied: "<<copied.eval(1,0)<<", assigned: "<<assigned.eval(1,0);
+  
+  TEST_PASSED;
+}
+
+/// Check indexing beyond 2^31 elements and with 32 bit indices
+void checkLargeTensIndex()
+{
+  /// Kind of the tensor
+  using Tk=
+    TensKind<Spacetime,RwSpin,RwCol,Compl>;
+  
+  /// Volume of a 64^4 lattice
+  const TensIdx vol=
+    64*64*64*64;
+  
+  /// Storage of the whole lattice, not allocated
+  const TensStor<Tk,double> large(DynSizes<1>{{vol}},nullptr);
+  
+  if(large.totSize!=vol*4*3*2)
+    CRASH<<"Total size of the storage is "<<large.totSize<<" instead of "<<vol*4*3*2;
+  
+  /// Index of the last element
+  const TensIdx last=
+    large.offset(IntsUpTo<Tk::nTypes>{},vol-1,3,2,1);
+  
+  if(last!=vol*4*3*2-1)
+    CRASH<<"Index of the last element is "<<last<<" instead of "<<vol*4*3*2-1;
+  
+  /// Storage indexed with 32 bits
+  TensStor<Tk,double,int32_t> small(10);
+  
+  static_assert(isSame<decltype(small.totSize),int32_t>,"Total size of the storage not indexed with 32 bit");
+  
+  if(small.totSize!=10*4*3*2)
+    CRASH<<"Total size of the storage is "<<small.totSize;
+  
+  small.eval(9,3,2,1)=
+    1.0;
+  
+  if(small._v[small.totSize-1]!=1.0)
+    CRASH<<"Last element of the storage not written";
+  
+  /// Tensor indexed with 32 bits
+  Tens<Tk,double,int32_t> smallTens(10);
+  
+  static_assert(isSame<Assigner<decltype(smallTens)&,decltype(smallTens)&>::Idx,int32_t>,"Assignment not indexed with the type of the l.h.s");
+  
+  smallTens=
+    2.0;
+  
+  if(smallTens.eval(9,3,2,1)!=2.0)
+    CRASH<<"Last element of the tensor assigned as "<<smallTens.eval(9,3,2,1);
+  
+  TEST_PASSED;
+}
+
+/// Check the strides of a tensor storage
+void checkTensStorStrides()
+{
+  /// Kind of the tensor, with a dynamic component in the middle
+  using Tk=
+    TensKind<RwCol,Spacetime,CnCol,Compl>;
+  
+  /// Storage type
+  using Stor=
+    TensStor<Tk,double>;
+  
+  static_assert(Stor::staticCompStrideOfPos<0> == DYNAMIC and
+		Stor::staticCompStrideOfPos<1> == 6 and
+		Stor::staticCompStrideOfPos<2> == 2 and
+		Stor::staticCompStrideOfPos<3> == 1,"Static strides not folded");
+  
+  /// Volume
+  const int vol=
+    5;
+  
+  /// Storage to index
+  Stor stor(vol);
+  
+  if(stor.compStride<RwCol>()!=vol*6)
+    CRASH<<"Stride of the dynamic component is "<<stor.compStride<RwCol>();
+  
+  for(int rc=0;rc<3;rc++)
+    for(int iSite=0;iSite<vol;iSite++)
+      for(int cc=0;cc<3;cc++)
+	for(int ri=0;ri<2;ri++)
+	  if(&stor.eval(rc,iSite,cc,ri)!=stor._v+ri+2*(cc+3*(iSite+vol*rc)))
+	    CRASH<<"Element "<<rc<<" "<<iSite<<" "<<cc<<" "<<ri<<" not matching the row-major layout";
+  
+  /// Pointer moved along the sites
+  double* ptr=
+    &stor.eval(1,0,2,1);
+  
+  for(int iSite=0;iSite<vol;iSite++)
+    {
+      if(ptr!=&stor.eval(1,iSite,2,1))
+	CRASH<<"Pointer advanced to site "<<iSite<<" not matching";
+      
+      stor.advance<Spacetime>(ptr);
+    }
+  
+  TEST_PASSED;
+}
+
+/// Check the assignment of expressions
+///
+/// The tensor is large enough to have the assignment split among the
+/// threads of the pool
+void checkAssign()
+{
+  /// Kind of the tensors
+  using Tk=
+    TensKind<Spacetime,RwSpin,RwCol,Compl>;
+  
+  /// Volume
+  const int vol=
+    1024;
+  
+  /// Tensors to be summed
+  Tens<Tk,double> a(vol),b(vol);
+  
+  /// Result
+  Tens<Tk,double> c(vol);
+  
+  /// Loops on all the elements
+  auto loop=
+    [vol](auto f)
+    {
+      for(int iSite=0;iSite<vol;iSite++)
+	for(int is=0;is<NSPIN;is++)
+	  for(int ic=0;ic<NCOL;ic++)
+	    for(int ri=0;ri<NCOMPL;ri++)
+	      f(iSite,is,ic,ri);
+    };
+  
+  loop([&a,&b](const int& iSite,const int& is,const int& ic,const int& ri)
+       {
+	 a.eval(iSite,is,ic,ri)=
+	   iSite+ri;
+	 b.eval(iSite,is,ic,ri)=
+	   is*ic;
+       });
+  
+  c=a+b;
+  
+  loop([&a,&b,&c](const int& iSite,const int& is,const int& ic,const int& ri)
+       {
+	 if(c.eval(iSite,is,ic,ri)!=a.eval(iSite,is,ic,ri)+b.eval(iSite,is,ic,ri))
+	   CRASH<<"Sum at "<<iSite<<" "<<is<<" "<<ic<<" "<<ri<<" is "<<c.eval(iSite,is,ic,ri);
+       });
+  
+  /// Tensor with less components, to be broadcast on the others
+  Tens<TensKind<RwCol,Compl>,double> d;
+  
+  for(int ic=0;ic<NCOL;ic++)
+    for(int ri=0;ri<NCOMPL;ri++)
+      d.eval(ic,ri)=
+	ic-ri;
+  
+  c=d;
+  
+  loop([&c,&d](const int& iSite,const int& is,const int& ic,const int& ri)
+       {
+	 if(c.eval(iSite,is,ic,ri)!=d.eval(ic,ri))
+	   CRASH<<"Broadcast at "<<iSite<<" "<<is<<" "<<ic<<" "<<ri<<" is "<<c.eval(iSite,is,ic,ri);
+       });
+  
+  TEST_PASSED;
+}
+
+/// Test the assignment vectorized along the innermost component
+void checkVectorizedAssign()
+{
+  /// Kind of the tensors, vectorized along the sites
+  using Tk=
+    TensKind<Compl,Spacetime>;
+  
+  /// Volume, not a multiple of the size of a SIMD pack
+  const int vol=
+    1001;
+  
+  /// Tensor to be conjugated
+  Tens<Tk,double> a(vol);
+  
+  /// Result
+  Tens<Tk,double> c(vol);
+  
+  static_assert(canEvalSIMD<decltype(-conj(a)+a)>,"Unable to vectorize the expression");
+  
+  for(int ri=0;ri<NCOMPL;ri++)
+    for(int iSite=0;iSite<vol;iSite++)
+      a.eval(ri,iSite)=
+	ri+2*iSite;
+  
+  c=-conj(a)+a;
+  
+  for(int ri=0;ri<NCOMPL;ri++)
+    for(int iSite=0;iSite<vol;iSite++)
+      if(c.eval(ri,iSite)!=2*ri*a.eval(ri,iSite))
+	CRASH<<"Site "<<iSite<<" component "<<ri<<" is "<<c.eval(ri,iSite)<<" instead of "<<2*ri*a.eval(ri,iSite);
+  
+  c=2.0;
+  
+  // Complex product, vectorized along the sites
+  c=mulAdd(a,a,c);
+  
+    for(int iSite=0;iSite<vol;iSite++)
+    {
+      /// Expected result
+      const std::complex<double> expected=
+	std::complex<double>(a.eval(0,iSite),a.eval(1,iSite))*std::complex<double>(a.eval(0,iSite),a.eval(1,iSite))+std::complex<double>(2.0,2.0);
+      
+      if(c.eval(0,iSite)!=expected.real() or c.eval(1,iSite)!=expected.imag())
+	CRASH<<"Site "<<iSite<<" is ("<<c.eval(0,iSite)<<","<<c.eval(1,iSite)<<") instead of ("<<expected.real()<<","<<expected.imag()<<")";
+    }
+  
+  /// Tensor with the complex components interleaved, to be gathered
+  Tens<TensKind<Spacetime,Compl>,double> b(vol);
+  
+  /// Result of the gathering
+  Tens<TensKind<Spacetime>,double> d(vol);
+  
+  for(int iSite=0;iSite<vol;iSite++)
+    for(int ri=0;ri<NCOMPL;ri++)
+      b.eval(iSite,ri)=
+	3*iSite-ri;
+  
+  d=imag(b);
+  
+  for(int iSite=0;iSite<vol;iSite++)
+    if(d.eval(iSite)!=b.eval(iSite,1))
+      CRASH<<"Site "<<iSite<<" is "<<d.eval(iSite)<<" instead of "<<b.eval(iSite,1);
+  
+  TEST_PASSED;
+}
+
+/// Test the SIMD backends and their runtime dispatch
+void checkSIMDBackends()
+{
+  static_assert(SIMDPack<double,SIMDBackend::SCALAR>::nComps==2,"Wrong width of the scalar backend");
+  static_assert(SIMDPack<double,SIMDBackend::SSE2>::nComps==2,"Wrong width of the SSE2 backend");
+  static_assert(SIMDPack<double,SIMDBackend::AVX2>::nComps==4,"Wrong width of the AVX2 backend");
+  static_assert(SIMDPack<float,SIMDBackend::AVX512>::nComps==16,"Wrong width of the AVX-512 backend");
+  static_assert(ALIGNMENT%SIMDBackendProps<COMPILE_TIME_SIMD_BACKEND>::size==0,"Alignment not suitable for the compile-time backend");
+  
+  if(simdBackend<COMPILE_TIME_SIMD_BACKEND)
+    CRASH<<"Backend "<<simdBackendName(simdBackend)<<" chosen at runtime is narrower than the compile-time one "<<simdBackendName(COMPILE_TIME_SIMD_BACKEND);
+  
+  /// Backend reached by the dispatch
+  SIMDBackend dispatched=
+    SIMDBackend::SCALAR;
+  
+  dispatchSIMDBackend([&dispatched](auto backend)
+		      {
+			dispatched=
+			  decltype(backend)::value;
+		      });
+
+#ifdef USE_SIMD_DISPATCH
+  if(dispatched!=simdBackend)
+    CRASH<<"Dispatched to "<<simdBackendName(dispatched)<<" instead of "<<simdBackendName(simdBackend);
+#else
+  if(dispatched!=COMPILE_TIME_SIMD_BACKEND)
+    CRASH<<"Dispatched to "<<simdBackendName(dispatched)<<" instead of "<<simdBackendName(COMPILE_TIME_SIMD_BACKEND);
+#endif
+  
+  /// Number of elements, not a multiple of any pack
+  const int n=
+    1001;
+  
+  /// Tensors to be assigned
+  Tens<TensKind<Spacetime>,double> a(n),b(n);
+  
+  for(int i=0;i<n;i++)
+    a.eval(i)=
+      i;
+  
+  // Run the assignment with the backend chosen at runtime
+  b=mulAdd(a,a,a);
+  
+  for(int i=0;i<n;i++)
+    if(b.eval(i)!=a.eval(i)*a.eval(i)+a.eval(i))
+      CRASH<<"Element "<<i<<" is "<<b.eval(i)<<" instead of "<<a.eval(i)*a.eval(i)+a.eval(i);
+  
+  TEST_PASSED;
+}
+
+/// Test the merging of components when assigning
+void checkMergedAssign()
+{
+  /// Kind of the tensors, all components can be merged
+  using Tk=
+    TensKind<Spacetime,RwSpin,RwCol,Compl>;
+  
+  /// Volume
+  const int vol=
+    7;
+  
+  /// Tensors to be combined
+  Tens<Tk,double> a(vol),b(vol),c(vol);
+  
+  for(int iSite=0;iSite<vol;iSite++)
+    for(int s=0;s<NSPIN;s++)
+      for(int ic=0;ic<NCOL;ic++)
+	for(int ri=0;ri<NCOMPL;ri++)
+	  {
+	    a.eval(iSite,s,ic,ri)=
+	      ((iSite*NSPIN+s)*NCOL+ic)*NCOMPL+ri;
+	    b.eval(iSite,s,ic,ri)=
+	      2*a.eval(iSite,s,ic,ri)+1;
+	  }
+  
+  // The sum runs on a single flat component
+  static_assert(AssignMergedTk<decltype(c)&,decltype(a+b)>::nTypes==1,"Unable to merge all components of a sum");
+  
+  c=a+b;
+  
+  for(int iSite=0;iSite<vol;iSite++)
+    for(int s=0;s<NSPIN;s++)
+      for(int ic=0;ic<NCOL;ic++)
+	for(int ri=0;ri<NCOMPL;ri++)
+	  if(c.eval(iSite,s,ic,ri)!=a.eval(iSite,s,ic,ri)+b.eval(iSite,s,ic,ri))
+	    CRASH<<"Sum at site "<<iSite<<" spin "<<s<<" color "<<ic<<" reim "<<ri<<" is "<<c.eval(iSite,s,ic,ri);
+  
+  // The conjugate keeps the complex component alone
+  static_assert(AssignMergedTk<decltype(c)&,decltype(conj(a))>::nTypes==2,"Wrong merging of the conjugate");
+  
+  c=conj(a);
+  
+  for(int iSite=0;iSite<vol;iSite++)
+    for(int s=0;s<NSPIN;s++)
+      for(int ic=0;ic<NCOL;ic++)
+	for(int ri=0;ri<NCOMPL;ri++)
+	  if(c.eval(iSite,s,ic,ri)!=(ri?-1:+1)*a.eval(iSite,s,ic,ri))
+	    CRASH<<"Conjugate at site "<<iSite<<" spin "<<s<<" color "<<ic<<" reim "<<ri<<" is "<<c.eval(iSite,s,ic,ri);
+  
+  /// Real part, merged leaving out the bound component
+  Tens<TensKind<Spacetime,RwSpin,RwCol>,double> d(vol);
+  
+  static_assert(AssignMergedTk<decltype(d)&,decltype(imag(a))>::nTypes==1,"Unable to merge the components of the imaginary part");
+  
+  d=imag(a);
+  
+  for(int iSite=0;iSite<vol;iSite++)
+    for(int s=0;s<NSPIN;s++)
+      for(int ic=0;ic<NCOL;ic++)
+	if(d.eval(iSite,s,ic)!=a.eval(iSite,s,ic,1))
+	  CRASH<<"Imaginary part at site "<<iSite<<" spin "<<s<<" color "<<ic<<" is "<<d.eval(iSite,s,ic);
+  
+  /// Tensor with permuted components, only the innermost ones can be merged
+  Tens<TensKind<RwSpin,Spacetime,RwCol,Compl>,double> e(vol);
+  
+  static_assert(AssignMergedTk<decltype(e)&,decltype(a)&>::nTypes==3,"Wrong merging of permuted components");
+  
+  e=a;
+  
+  for(int iSite=0;iSite<vol;iSite++)
+    for(int s=0;s<NSPIN;s++)
+      for(int ic=0;ic<NCOL;ic++)
+	for(int ri=0;ri<NCOMPL;ri++)
+	  if(e.eval(s,iSite,ic,ri)!=a.eval(iSite,s,ic,ri))
+	    CRASH<<"Permuted copy at site "<<iSite<<" spin "<<s<<" color "<<ic<<" reim "<<ri<<" is "<<e.eval(s,iSite,ic,ri);
+  
+  /// Kind of a tensor with twinned components
+  using TwTk=
+    TensKind<Spacetime,Compl,RwSpin,CnSpin>;
+  
+  /// Tensors to be transposed
+  Tens<TwTk,double> f(vol);
+  Tens<typename TwTk::Twinned,double> g(vol);
+  
+  for(int iSite=0;iSite<vol;iSite++)
+    for(int ri=0;ri<NCOMPL;ri++)
+      for(int rs=0;rs<NSPIN;rs++)
+	for(int cs=0;cs<NSPIN;cs++)
+	  f.eval(iSite,ri,rs,cs)=
+	    ((iSite*NCOMPL+ri)*NSPIN+rs)*NSPIN+cs;
+  
+  // Only the outermost components are merged, the transposition is kept
+  transpose(g)=f;
+  
+  for(int iSite=0;iSite<vol;iSite++)
+    for(int ri=0;ri<NCOMPL;ri++)
+      for(int rs=0;rs<NSPIN;rs++)
+	for(int cs=0;cs<NSPIN;cs++)
+	  if(cnSpin(rwSpin(g,rs),cs).eval(iSite,ri)!=rwSpin(cnSpin(f,rs),cs).eval(iSite,ri))
+	    CRASH<<"Transposed at site "<<iSite<<" reim "<<ri<<" row "<<rs<<" column "<<cs<<" is "<<cnSpin(rwSpin(g,rs),cs).eval(iSite,ri);
+  
+  TEST_PASSED;
+}
+
+/// Test the complex multiply-add
+void checkComplMulAdd()
+{
+  /// Kind of the vectors, with interleaved real and imaginary part
+  using Tk=
+    TensKind<Spacetime,RwSpin,Compl>;
+  
+  /// Volume, such that the number of complex is odd
+  const int vol=
+    13;
+  
+  /// Vectors to be combined
+  Tens<Tk,double> x(vol),y(vol),z(vol);
+  
+  /// Complex scalar
+  Tens<TensKind<Compl>,double> alpha;
+  
+  alpha.eval(0)=
+    1.5;
+  alpha.eval(1)=
+    -0.25;
+  
+  /// Gets the complex number in a vector
+  auto c=
+    [](const Tens<Tk,double>& v,const int iSite,const int s)
+    {
+      return
+	std::complex<double>(v.eval(iSite,s,0),v.eval(iSite,s,1));
+    };
+  
+  for(int iSite=0;iSite<vol;iSite++)
+    for(int s=0;s<NSPIN;s++)
+      for(int ri=0;ri<NCOMPL;ri++)
+	{
+	  x.eval(iSite,s,ri)=
+	    iSite-2*s+ri;
+	  y.eval(iSite,s,ri)=
+	    3*s-iSite*ri+1;
+	}
+  
+  // Product of vectors, merged into a single component with interleaved complex
+  static_assert(AssignMergedTk<decltype(z)&,decltype(mulAdd(x,y,y))>::nTypes==1,"Unable to merge the complex product");
+  
+  z=mulAdd(x,y,y);
+  
+  for(int iSite=0;iSite<vol;iSite++)
+    for(int s=0;s<NSPIN;s++)
+      {
+	/// Expected result
+	const std::complex<double> expected=
+	  c(x,iSite,s)*c(y,iSite,s)+c(y,iSite,s);
+	
+	if(c(z,iSite,s)!=expected)
+	  CRASH<<"Product at site "<<iSite<<" spin "<<s<<" is ("<<z.eval(iSite,s,0)<<","<<z.eval(iSite,s,1)<<") instead of ("<<expected.real()<<","<<expected.imag()<<")";
+      }
+  
+  // Caxpy, the complex component is kept separated
+  static_assert(AssignMergedTk<decltype(z)&,decltype(mulAdd(alpha,x,y))>::nTypes==2,"Wrong merging of the caxpy");
+  
+  z=mulAdd(alpha,x,y);
+  
+  /// Complex scalar
+  const std::complex<double> a(alpha.eval(0),alpha.eval(1));
+  
+  for(int iSite=0;iSite<vol;iSite++)
+    for(int s=0;s<NSPIN;s++)
+      {
+	/// Expected result
+	const std::complex<double> expected=
+	  a*c(x,iSite,s)+c(y,iSite,s);
+	
+	if(c(z,iSite,s)!=expected)
+	  CRASH<<"Caxpy at site "<<iSite<<" spin "<<s<<" is ("<<z.eval(iSite,s,0)<<","<<z.eval(iSite,s,1)<<") instead of ("<<expected.real()<<","<<expected.imag()<<")";
+      }
+  
+  /// Real vector
+  Tens<TensKind<Spacetime,RwSpin>,double> r(vol);
+  
+  for(int iSite=0;iSite<vol;iSite++)
+    for(int s=0;s<NSPIN;s++)
+      r.eval(iSite,s)=
+	iSite*s-3;
+  
+  // Real times complex, elementwise
+  z=mulAdd(r,x,y);
+  
+  for(int iSite=0;iSite<vol;iSite++)
+    for(int s=0;s<NSPIN;s++)
+      {
+	/// Expected result
+	const std::complex<double> expected=
+	  r.eval(iSite,s)*c(x,iSite,s)+c(y,iSite,s);
+	
+	if(c(z,iSite,s)!=expected)
+	  CRASH<<"Real times complex at site "<<iSite<<" spin "<<s<<" is ("<<z.eval(iSite,s,0)<<","<<z.eval(iSite,s,1)<<") instead of ("<<expected.real()<<","<<expected.imag()<<")";
+      }
+  
+  TEST_PASSED;
+}
+
+namespace SUNphi
+{
+  // Define a dynamic twinned component, to check the blocked contraction
+  DEFINE_RW_CN_TENS_COMP(flav,Flav,FLAV,DYNAMIC);
+}
+
+/// Check the contraction of twinned components
+void checkContraction()
+{
+  /// Kind of the links
+  using LinkTk=
+    TensKind<Spacetime,RwCol,CnCol,Compl>;
+  
+  /// Kind of the color vectors
+  using ColVecTk=
+    TensKind<Spacetime,CnCol,Compl>;
+  
+  /// Volume, not a multiple of the size of a SIMD pack
+  const int vol=
+    13;
+  
+  /// Links to be multiplied
+  Tens<LinkTk,double> u(vol),v(vol),w(vol);
+  
+  /// Color vectors
+  Tens<ColVecTk,double> x(vol),y(vol);
+  
+  static_assert(isSame<TkOf<decltype(u*v)>,LinkTk>,"Wrong components of the matrix-matrix product");
+  static_assert(isSame<TkOf<decltype(u*x)>,ColVecTk>,"Wrong components of the matrix-vector product");
+  
+  /// Assigner of the matrix-vector product
+  using MatVecAssigner=
+    Assigner<decltype(y)&,decltype(u*x)>;
+  
+  static_assert(MatVecAssigner::isVectorizable<SIMDBackend::AVX2>() and
+		MatVecAssigner::posOfVectorizedComp<SIMDBackend::AVX2>()==0,
+		"The matrix-vector product is not vectorized along the sites");
+  
+  for(int iSite=0;iSite<vol;iSite++)
+    for(int ic1=0;ic1<NCOL;ic1++)
+      for(int ri=0;ri<NCOMPL;ri++)
+	{
+	  x.eval(iSite,ic1,ri)=
+	    iSite-ic1+2*ri;
+	  
+	  for(int ic2=0;ic2<NCOL;ic2++)
+	    {
+	      u.eval(iSite,ic1,ic2,ri)=
+		iSite+ic1-2*ic2+ri;
+	      v.eval(iSite,ic1,ic2,ri)=
+		3*ic1-iSite*ri+ic2;
+	    }
+	}
+  
+  /// Gets the complex number in a link
+  auto cl=
+    [](const Tens<LinkTk,double>& l,const int iSite,const int ic1,const int ic2)
+    {
+      return
+	std::complex<double>(l.eval(iSite,ic1,ic2,0),l.eval(iSite,ic1,ic2,1));
+    };
+  
+  /// Gets the complex number in a color vector
+  auto cv=
+    [](const Tens<ColVecTk,double>& c,const int iSite,const int ic)
+    {
+      return
+	std::complex<double>(c.eval(iSite,ic,0),c.eval(iSite,ic,1));
+    };
+  
+  w=u*v;
+  y=u*x;
+  
+  for(int iSite=0;iSite<vol;iSite++)
+    for(int ic1=0;ic1<NCOL;ic1++)
+      {
+	/// Expected matrix-vector product
+	std::complex<double> expectedVec=
+	  0;
+	
+	for(int ic2=0;ic2<NCOL;ic2++)
+	  {
+	    expectedVec+=
+	      cl(u,iSite,ic1,ic2)*cv(x,iSite,ic2);
+	    
+	    /// Expected matrix-matrix product
+	    std::complex<double> expected=
+	      0;
+	    
+	    for(int ic3=0;ic3<NCOL;ic3++)
+	      expected+=
+		cl(u,iSite,ic1,ic3)*cl(v,iSite,ic3,ic2);
+	    
+	    if(cl(w,iSite,ic1,ic2)!=expected)
+	      CRASH<<"Matrix product at site "<<iSite<<" entry "<<ic1<<","<<ic2<<" is ("<<w.eval(iSite,ic1,ic2,0)<<","<<w.eval(iSite,ic1,ic2,1)<<") instead of ("<<expected.real()<<","<<expected.imag()<<")";
+	  }
+	
+	if(cv(y,iSite,ic1)!=expectedVec)
+	  CRASH<<"Matrix-vector product at site "<<iSite<<" entry "<<ic1<<" is ("<<y.eval(iSite,ic1,0)<<","<<y.eval(iSite,ic1,1)<<") instead of ("<<expectedVec.real()<<","<<expectedVec.imag()<<")";
+      }
+  
+  u=u*v;
+  
+  for(int iSite=0;iSite<vol;iSite++)
+    for(int ic1=0;ic1<NCOL;ic1++)
+      for(int ic2=0;ic2<NCOL;ic2++)
+	if(cl(u,iSite,ic1,ic2)!=cl(w,iSite,ic1,ic2))
+	  CRASH<<"Matrix product assigned to the first factor at site "<<iSite<<" entry "<<ic1<<","<<ic2<<" is ("<<u.eval(iSite,ic1,ic2,0)<<","<<u.eval(iSite,ic1,ic2,1)<<") instead of ("<<w.eval(iSite,ic1,ic2,0)<<","<<w.eval(iSite,ic1,ic2,1)<<")";
+  
+  /// Copy of the first factor
+  Tens<LinkTk,double> u0=
+    u.clone();
+  
+  static_assert(containsContracter<decltype(u*v+u0)>(),"Unable to find the contraction nested in a sum");
+  static_assert(containsContracter<decltype(-(u*v))>(),"Unable to find the contraction nested in a unary minus");
+  static_assert(not containsContracter<decltype(u+v)>(),"Found a contraction in a sum");
+  
+  u=u*v+u0;
+  
+  for(int iSite=0;iSite<vol;iSite++)
+    for(int ic1=0;ic1<NCOL;ic1++)
+      for(int ic2=0;ic2<NCOL;ic2++)
+	{
+	  /// Expected result
+	  std::complex<double> expected=
+	    cl(u0,iSite,ic1,ic2);
+	  
+	  for(int ic3=0;ic3<NCOL;ic3++)
+	    expected+=
+	      cl(u0,iSite,ic1,ic3)*cl(v,iSite,ic3,ic2);
+	  
+	  if(cl(u,iSite,ic1,ic2)!=expected)
+	    CRASH<<"Matrix product nested in a sum assigned to the first factor at site "<<iSite<<" entry "<<ic1<<","<<ic2<<" is ("<<u.eval(iSite,ic1,ic2,0)<<","<<u.eval(iSite,ic1,ic2,1)<<") instead of ("<<expected.real()<<","<<expected.imag()<<")";
+	}
+  
+  u0=u;
+  u=-(u*v);
+  
+  for(int iSite=0;iSite<vol;iSite++)
+    for(int ic1=0;ic1<NCOL;ic1++)
+      for(int ic2=0;ic2<NCOL;ic2++)
+	{
+	  /// Expected result
+	  std::complex<double> expected=
+	    0;
+	  
+	  for(int ic3=0;ic3<NCOL;ic3++)
+	    expected-=
+	      cl(u0,iSite,ic1,ic3)*cl(v,iSite,ic3,ic2);
+	  
+	  if(cl(u,iSite,ic1,ic2)!=expected)
+	    CRASH<<"Opposite of the matrix product assigned to the first factor at site "<<iSite<<" entry "<<ic1<<","<<ic2<<" is ("<<u.eval(iSite,ic1,ic2,0)<<","<<u.eval(iSite,ic1,ic2,1)<<") instead of ("<<expected.real()<<","<<expected.imag()<<")";
+	}
+  
+  /// Spin matrix, broadcast over the field
+  Tens<TensKind<RwSpin,CnSpin,Compl>,double> g;
+  
+  /// Spinors
+  Tens<TensKind<Spacetime,CnSpin,CnCol,Compl>,double> psi(vol),chi(vol);
+  
+  for(int is1=0;is1<NSPIN;is1++)
+    for(int ri=0;ri<NCOMPL;ri++)
+      {
+	for(int is2=0;is2<NSPIN;is2++)
+	  g.eval(is1,is2,ri)=
+	    (is1==(is2^1))*(1-2*ri);
+	
+	for(int iSite=0;iSite<vol;iSite++)
+	  for(int ic=0;ic<NCOL;ic++)
+	    psi.eval(iSite,is1,ic,ri)=
+	      iSite*is1-ic+ri;
+      }
+  
+  chi=g*psi;
+  
+  for(int iSite=0;iSite<vol;iSite++)
+    for(int is1=0;is1<NSPIN;is1++)
+      for(int ic=0;ic<NCOL;ic++)
+	{
+	  /// Expected result
+	  std::complex<double> expected=
+	    0;
+	  
+	  for(int is2=0;is2<NSPIN;is2++)
+	    expected+=
+	      std::complex<double>(g.eval(is1,is2,0),g.eval(is1,is2,1))*
+	      std::complex<double>(psi.eval(iSite,is2,ic,0),psi.eval(iSite,is2,ic,1));
+	  
+	  if(std::complex<double>(chi.eval(iSite,is1,ic,0),chi.eval(iSite,is1,ic,1))!=expected)
+	    CRASH<<"Spin matrix times spinor at site "<<iSite<<" spin "<<is1<<" color "<<ic<<" is ("<<chi.eval(iSite,is1,ic,0)<<","<<chi.eval(iSite,is1,ic,1)<<") instead of ("<<expected.real()<<","<<expected.imag()<<")";
+	}
+  
+  /// Size of the dynamic component, larger than a block
+  const int n=
+    2*CONTRACTION_BLOCK_SIZE+3;
+  
+  /// Dynamic matrices
+  Tens<TensKind<RwFlav,CnFlav>,double> a(n,n),b(n,n),d(n,n);
+  
+  /// Dynamic vectors
+  Tens<TensKind<CnFlav>,double> p(n),q(n);
+  
+  for(int i=0;i<n;i++)
+    {
+      p.eval(i)=
+	i%7-3;
+      
+      for(int j=0;j<n;j++)
+	{
+	  a.eval(i,j)=
+	    (i+2*j)%5-2;
+	  b.eval(i,j)=
+	    (3*i-j)%4;
+	}
+    }
+  
+  static_assert(canAssignContractionInTiles<decltype(d)&,decltype(a*b)>(),"The dynamic matrix product is not assigned in tiles");
+  
+  d=a*b;
+  q=a*p;
+  
+  for(int i=0;i<n;i++)
+    {
+      /// Expected matrix-vector product
+      double expectedVec=
+	0;
+      
+      for(int j=0;j<n;j++)
+	{
+	  expectedVec+=
+	    a.eval(i,j)*p.eval(j);
+	  
+	  /// Expected matrix-matrix product
+	  double expected=
+	    0;
+	  
+	  for(int k=0;k<n;k++)
+	    expected+=
+	      a.eval(i,k)*b.eval(k,j);
+	  
+	  if(d.eval(i,j)!=expected)
+	    CRASH<<"Dynamic matrix product entry "<<i<<","<<j<<" is "<<d.eval(i,j)<<" instead of "<<expected;
+	}
+      
+      if(q.eval(i)!=expectedVec)
+	CRASH<<"Dynamic matrix-vector product entry "<<i<<" is "<<q.eval(i)<<" instead of "<<expectedVec;
+    }
+  
+  /// Transposed result, which cannot be assigned in tiles
+  Tens<TensKind<CnFlav,RwFlav>,double> e(n,n);
+  
+  static_assert(not canAssignContractionInTiles<decltype(e)&,decltype(a*b)>(),"The transposed matrix product cannot be assigned in tiles");
+  
+  e=a*b;
+  
+  for(int i=0;i<n;i++)
+    for(int j=0;j<n;j++)
+      if(e.eval(j,i)!=d.eval(i,j))
+	CRASH<<"Dynamic matrix product assigned transposed entry "<<j<<","<<i<<" is "<<e.eval(j,i)<<" instead of "<<d.eval(i,j);
+  
+  a=a*b;
+  
+  for(int i=0;i<n;i++)
+    for(int j=0;j<n;j++)
+      if(a.eval(i,j)!=d.eval(i,j))
+	CRASH<<"Dynamic matrix product assigned to the first factor entry "<<i<<","<<j<<" is "<<a.eval(i,j)<<" instead of "<<d.eval(i,j);
+  
+  TEST_PASSED;
+}
+
 /// Test adding and removing of signness
 void checkSignUnsign()
 {
@@ -1356,8 +2932,7 @@ int main()
   
   checkTensKindIscontained();
   
-  // this is not passing...
-  //checkCallOperator();
+  checkCallOperator();
   
   checkGrid();
   
@@ -1381,6 +2956,58 @@ int main()
   
   checkMPIallReduce();
   
+  checkTaskScheduler();
+  
+  checkLoopSplitScheduling();
+  
+  checkLoopSplitReduce();
+  
+  checkParseCoreList();
+  
+  checkThreadIdAfterResize();
+  
+  checkBarrier();
+  
+  checkAsyncWork();
+  
+  checkThreadTeams();
+  
+  checkMemoryCrossThreadRelease();
+  
+  checkCopyInParallel();
+  
+  checkMemoryCacheEviction();
+  
+  checkMemoryCacheEvictionByOwner();
+  
+  checkMemoryHugePages();
+  
+  checkMemoryTags();
+  
+  checkInlineTensStor();
+  
+  checkMappedTensStor();
+  
+  checkMergedCompsViewSharesStorage();
+  
+  checkTensMoveAndClone();
+  
+  checkLargeTensIndex();
+  
+  checkTensStorStrides();
+  
+  checkAssign();
+  
+  checkVectorizedAssign();
+  
+  checkSIMDBackends();
+  
+  checkMergedAssign();
+  
+  checkComplMulAdd();
+  
+  checkContraction();
+  
   checkSitmo();
   
   checkSerializer();
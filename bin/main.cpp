@@ -1,6 +1,5 @@
 //#define DEBUG_TENS
 //#define DEBUG_BINDER
-//#define DEBUG_INDEXER
 //#define DEBUG_REL_BINDER
 
 #include <SUNphi.hpp>
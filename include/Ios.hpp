@@ -7,6 +7,7 @@
 
 #include <ios/File.hpp>
 #include <ios/Logger.hpp>
+#include <ios/MappedFile.hpp>
 #include <ios/MinimalLogger.hpp>
 #include <ios/TextFormat.hpp>
 
@@ -12,6 +12,7 @@
 #include <smet/BinarySmET.hpp>
 #include <smet/Bind.hpp>
 #include <smet/Conj.hpp>
+#include <smet/Contract.hpp>
 #include <smet/MulAdd.hpp>
 #include <smet/NnarySmET.hpp>
 #include <smet/Reference.hpp>
@@ -5,7 +5,6 @@
 ///
 /// \brief Header file for the inclusion of all tensor description
 
-#include <tens/Indexer.hpp>
 #include <tens/TensClass.hpp>
 #include <tens/TensComp.hpp>
 #include <tens/TensKind.hpp>
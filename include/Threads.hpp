@@ -12,5 +12,7 @@
 #include <threads/Barrier.hpp>
 #include <threads/Mutex.hpp>
 #include <threads/Pool.hpp>
+#include <threads/TaskScheduler.hpp>
+#include <threads/Teams.hpp>
 
 #endif
@@ -113,6 +113,15 @@ namespace SUNphi
 			      ToIns::size==IncrAft::size>>      // Checks that ToIns and IncrAft have the same number of entries
   using InsertIntSeqInOrderedIntSeq=
     decltype(_InsertIntSeqInOrderedIntSeq<IgnoreIfPresent>(ToIns{},IncrAft{},Is{}));
+  
+  /// Sorts an IntSeq, dropping duplicated elements
+  ///
+  /// \code
+  /// using A=SortedUniqueIntSeq<IntSeq<3,0,1,3>>; // IntSeq<0,1,3>
+  /// \endcode
+  template <typename Is>  // IntSeq to be sorted
+  using SortedUniqueIntSeq=
+    InsertIntSeqInOrderedIntSeq<Is,IntSeq<>,IntSeqOfSameNumb<Is::size,0>,true>;
 }
 
 #endif
@@ -0,0 +1,217 @@
+#ifndef _MAPPEDFILE_HPP
+#define _MAPPEDFILE_HPP
+
+/// \file MappedFile.hpp
+///
+/// \brief Maps a file in memory
+///
+/// The content of the file is accessed directly through a pointer,
+/// with no copy: the pages are read lazily by the kernel when first
+/// accessed, and can be prefetched in advance.
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+#include <debug/MinimalCrash.hpp>
+
+namespace SUNphi
+{
+  /// Way in which a file is mapped
+  enum class FileMapping{READ_ONLY,       ///< The memory cannot be written
+			 COPY_ON_WRITE};  ///< The memory can be written, the changes are not propagated to the file
+  
+  /// File mapped in memory
+  ///
+  /// The mapping is released at destruction
+  class MappedFile
+  {
+    /// Beginning of the mapped region
+    void* beg{nullptr};
+    
+    /// Size of the mapped region
+    size_t size{0};
+    
+    /// Pointer to the requested offset of the file
+    void* data{nullptr};
+  
+  public:
+    
+    /// Check if a file is mapped
+    bool isMapped()
+      const
+    {
+      return
+	beg!=nullptr;
+    }
+    
+    /// Pointer to the requested part of the file
+    void* getData()
+      const
+    {
+      return
+	data;
+    }
+    
+    /// Maps a region of a file, crashing if impossible
+    ///
+    /// The offset needs not to be aligned to the page, the mapping is
+    /// extended to the beginning of the page
+    void map(const std::filesystem::path& path,                ///< Path to map
+	     const size_t length,                              ///< Length of the region to map
+	     const FileMapping& mode=FileMapping::READ_ONLY,   ///< Mode used to map
+	     const size_t offset=0)                            ///< Offset of the region inside the file
+    {
+      if(isMapped())
+	MINIMAL_CRASH("Cannot map an already mapped file");
+      
+      if(length==0)
+	MINIMAL_CRASH("Cannot map an empty region of file %s",path.c_str());
+      
+      /// File descriptor
+      const int fd=
+	open(path.c_str(),O_RDONLY);
+      
+      if(fd<0)
+	MINIMAL_CRASH_STDLIBERR("opening the file to be mapped");
+      
+      /// Status of the file
+      struct stat fileStat;
+      
+      if(fstat(fd,&fileStat)!=0)
+	MINIMAL_CRASH_STDLIBERR("getting the size of the file to be mapped");
+      
+      if(offset+length>(size_t)fileStat.st_size)
+	MINIMAL_CRASH("File %s has size %zu, smaller than the %zu bytes requested at offset %zu",path.c_str(),(size_t)fileStat.st_size,length,offset);
+      
+      /// Size of the page
+      const size_t pageSize=
+	sysconf(_SC_PAGESIZE);
+      
+      /// Offset of the beginning of the page containing the region
+      const size_t pageOffset=
+	offset/pageSize*pageSize;
+      
+      size=
+	offset-pageOffset+length;
+      
+      /// Protection of the pages
+      const int prot=
+	(mode==FileMapping::READ_ONLY)?PROT_READ:(PROT_READ|PROT_WRITE);
+      
+      /// Mapping is shared if read-only, to reuse the page cache
+      const int flags=
+	(mode==FileMapping::READ_ONLY)?MAP_SHARED:MAP_PRIVATE;
+      
+      /// Result of the mapping
+      void* res=
+	mmap(nullptr,size,prot,flags,fd,pageOffset);
+      
+      // The mapping survives the closure of the file
+      close(fd);
+      
+      if(res==MAP_FAILED)
+	MINIMAL_CRASH_STDLIBERR("mapping the file");
+      
+      beg=
+	res;
+      
+      data=
+	static_cast<char*>(beg)+(offset-pageOffset);
+    }
+    
+    /// Asks the kernel to read in advance the mapped region
+    void prefetch()
+      const
+    {
+      if(isMapped())
+	madvise(beg,size,MADV_WILLNEED);
+    }
+    
+    /// Tells the kernel that the mapped region will be accessed sequentially
+    void adviseSequentialAccess()
+      const
+    {
+      if(isMapped())
+	madvise(beg,size,MADV_SEQUENTIAL);
+    }
+    
+    /// Releases the mapping
+    void unmap()
+    {
+      if(isMapped())
+	{
+	  if(munmap(beg,size)!=0)
+	    MINIMAL_CRASH_STDLIBERR("unmapping the file");
+	  
+	  beg=
+	    data=
+	    nullptr;
+	  
+	  size=
+	    0;
+	}
+    }
+    
+    /// Default constructor, not mapping anything
+    MappedFile()
+    {
+    }
+    
+    /// Maps the region of a file
+    MappedFile(const std::filesystem::path& path,                ///< Path to map
+	       const size_t length,                              ///< Length of the region to map
+	       const FileMapping& mode=FileMapping::READ_ONLY,   ///< Mode used to map
+	       const size_t offset=0)                            ///< Offset of the region inside the file
+    {
+      map(path,length,mode,offset);
+    }
+    
+    /// Forbids copy
+    MappedFile(const MappedFile&)=
+      delete;
+    
+    /// Move constructor, taking the mapping
+    MappedFile(MappedFile&& oth) :
+      beg(oth.beg),
+      size(oth.size),
+      data(oth.data)
+    {
+      oth.beg=
+	oth.data=
+	nullptr;
+      
+      oth.size=
+	0;
+    }
+    
+    /// Move assignment, unmapping the previous mapping
+    MappedFile& operator=(MappedFile&& oth)
+    {
+      if(this!=&oth)
+	{
+	  unmap();
+	  
+	  std::swap(beg,oth.beg);
+	  std::swap(size,oth.size);
+	  std::swap(data,oth.data);
+	}
+      
+      return
+	*this;
+    }
+    
+    /// Destructor, unmapping
+    ~MappedFile()
+    {
+      unmap();
+    }
+  };
+}
+
+#endif
@@ -335,18 +335,22 @@ namespace SUNphi
   /////////////////////////////////////////////////////////////////
   
   /// Remove \c const qualifier from anything
-  ///
-  /// \todo  Check that  the  "dangling  reference forbidding"  below,
-  /// currently not working, is not actually necessary
   template <typename T>
   constexpr T& asMutable(const T& v) noexcept
   {
     return const_cast<T&>(v);
   }
   
-  // /// Forbids a dangling reference
-  // template <typename T>
-  // void asMutable(const T&&)=delete;
+  /// Returns a copy of a temporary
+  ///
+  /// Returning a reference would dangle, as the temporary is
+  /// destroyed at the end of the full expression calling
+  /// \c asMutable, e.g. when a const method returns by value
+  template <typename T>
+  constexpr T asMutable(const T&& v)
+  {
+    return v;
+  }
   
   /// Call a const method removing any const qualifier
 #define CALL_CLASS_CONST_METHOD_REMOVING_CONST(...)	\
@@ -34,6 +34,55 @@ namespace SUNphi
   {
     return reIm(forw<T>(ref),IMAG_PART_ID);
   }
+  
+  /// Check whether a \c TensComp is \c Compl
+  ///
+  /// Default case, a non-merged component
+  template <typename TC>       // \c TensComp to check
+  constexpr bool _endsWithCompl(TC*)
+  {
+    return
+      isSame<TC,Compl>;
+  }
+  
+  /// Check whether a \c TensComp is merged with \c Compl as innermost component
+  template <typename...Tcs,    // Merged components
+	    int Size,          // Size of the merged component
+	    int MaxKnownSubMul> // Known submultiple of the size
+  constexpr bool _endsWithCompl(TensComp<Tuple<Tcs...>,Size,MaxKnownSubMul>*)
+  {
+    return
+      isSame<TupleElementType<sizeof...(Tcs)-1,Tuple<Tcs...>>,Compl>;
+  }
+  
+  /// Check whether a \c TensComp has \c Compl as innermost component
+  ///
+  /// This is the case for \c Compl itself, and for the component
+  /// obtained merging \c Compl with the ones preceding it, in which
+  /// real and imaginary parts are interleaved
+  template <typename TC>       // \c TensComp to check
+  [[ maybe_unused ]]
+  constexpr bool endsWithCompl=
+    _endsWithCompl((TC*)nullptr);
+  
+  /// Check whether a \c TensKind contains \c Compl, possibly merged in the innermost component
+  template <typename TK>       // \c TensKind to check
+  constexpr bool _isComplTensKind()
+  {
+    if constexpr(TK::nTypes==0)
+      return
+	false;
+    else
+      return
+	tupleHasType<Compl,typename TK::types> or
+	endsWithCompl<TupleElementType<TK::nTypes-1,typename TK::types>>;
+  }
+  
+  /// Check whether a \c TensKind contains \c Compl, possibly merged in the innermost component
+  template <typename TK>       // \c TensKind to check
+  [[ maybe_unused ]]
+  constexpr bool isComplTensKind=
+    _isComplTensKind<TK>();
 }
 
 #endif
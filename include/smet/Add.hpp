@@ -23,10 +23,10 @@ namespace SUNphi
     public ConstrainAreSmETs<_Refs...>       // Constrain all \c Refs to be \c SmET
   {
     
-    PROVIDE_NNARY_SMET_REFS_AND_CHECK_ARE_N(2);
-    
   public:
     
+    PROVIDE_NNARY_SMET_REFS_AND_CHECK_ARE_N(2);
+    
     /// Position of the references
     enum Pos_t{ADDEND1,
 	       ADDEND2};
@@ -37,7 +37,7 @@ namespace SUNphi
     static DECLAUTO representativeFunction(Addend1&& addend1,   ///< First addend
 					   Addend2&& addend2)   ///< Second addend
     {
-      return addend1+addend2;
+      return forw<Addend1>(addend1)+forw<Addend2>(addend2);
     }
     
     PROVIDE_SIMPLE_NNARY_COMP_SIZE;
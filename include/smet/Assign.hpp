@@ -13,29 +13,39 @@
 /// - All call to \c assign where \c B is not a \c SmET are intercepted.
 ///   If \c B fundamental type is of a type that can be cast to the fundamental
 ///   type of A, then we return \c A=scalar(B). Otherwise an exception is issued.
-/// - If B does not contain all components of \c A, an exception is issued.
+/// - If \c A does not contain all components of \c B, an exception is issued.
 /// - Preliminary manipulation is performed, allowing to specific pattern recognition,
 ///   obtained by overloading \c assign and using appropriate \c SFINAE mechanism.
 /// - The default \c assign function is called, which returns the rhs as expected
 ///   allowing to perform chain assignement on the expected return.
 /// - The \c Assigner is created inside assign.
 /// - If the \c Assigner has mergeable components, they are merged.
-/// - If the innermost component is vectorizable, it is vectorized.
-/// - The execution of the assigner is dispatched to the thread pool.
+/// - The innermost component is vectorized, or the innermost dynamic
+///   one if the former is smaller than a SIMD pack.
+/// - The execution of the assigner is dispatched to the thread pool:
+///   the outermost component of the merged \c Assigner is split among
+///   the threads, and the other components are looped nested inside.
+///   Each thread runs its chunk with the SIMD backend chosen at runtime.
 ///
 
 #include <ios/Logger.hpp>
 #include <smet/BinarySmET.hpp>
 #include <smet/Reference.hpp>
 #include <smet/ScalarWrap.hpp>
+#include <system/Memory.hpp>
+#include <system/SIMD.hpp>
+#include <tuple/TupleOrder.hpp>
 
 namespace SUNphi
 {
   /// Defines the assignement operator, calling assign
 #define PROVIDE_SMET_ASSIGNEMENT_OPERATOR(UNARY_SMET /*!< Name of the NnarySmET */) \
-  /*! Assign from another object */					\
+  /*! Assign from another object                                 */	\
+  /*!                                                           */	\
+  /*! The returned type is explicit, so that checking whether the */	\
+  /*! \c SmET is assignable does not instantiate the assignment   */	\
   template <typename Oth>             	/* Other type  */		\
-  DECLAUTO operator=(Oth&& oth)	        /*!< Other object */		\
+  UNARY_SMET& operator=(Oth&& oth)	/*!< Other object */		\
   {									\
     if(0)								\
       {									\
@@ -69,15 +79,212 @@ namespace SUNphi
 		  FundTypeOf<_Ref1>>,
 		  "Need to be able to convert the r.h.s into l.h.s fundamental types");
     
+    // Check that the r.h.s does not contain components absent in the l.h.s
+    static_assert(TK1::template contains<TK2>,"The r.h.s contains components not present in the l.h.s");
+    
+  public:
+    
+    /// Type used to index, taken from the storage of the l.h.s
+    using Idx=
+      typename RemRef<decltype(getStor(std::declval<_Ref1&>()))>::Idx;
+    
+  private:
+    
+    /// Position of the \c TensComp of the r.h.s in the l.h.s \c TensKind
+    using PosOfRhsTcsInLhsTk=
+      PosOfTypes<typename TK2::types,typename TK1::types>;
+    
+    /// Evaluates the r.h.s, passing the components of the l.h.s by name
+    template <int...Pos,          // Position of the r.h.s components among the l.h.s ones
+	      typename...Args>    // Type of the components
+    DECLAUTO evalRhsByCompsName(IntSeq<Pos...>,
+				const Args&...args)  ///< Components of the l.h.s
+      const
+    {
+      return
+	ref2.eval(get<Pos>(std::forward_as_tuple(args...))...);
+    }
+    
+    /// Assigns the element of the l.h.s with the given components
+    template <typename...Args>  // Type of the components
+    void assignElement(const Args&...args)  ///< Components of the l.h.s
+    {
+      ref1.eval(args...)=
+	evalRhsByCompsName(PosOfRhsTcsInLhsTk{},args...);
+    }
+    
+  public:
+    
+    /// Position of the component along which the assignment is vectorized with backend B
+    ///
+    /// The innermost component is chosen, if it is not statically
+    /// smaller than a pack. Otherwise the innermost dynamic
+    /// component is chosen, such as \c Spacetime when the innermost
+    /// one is \c Compl, so that packs are filled with elements
+    /// separated by a stride. \c NOT_PRESENT is returned if no
+    /// component is suitable.
+    template <SIMDBackend B>  // SIMD backend
+    static constexpr int posOfVectorizedComp()
+    {
+      if constexpr(TK1::nTypes==0)
+	return
+	  NOT_PRESENT;
+      else
+	{
+	  /// Innermost component
+	  using IC=
+	    TupleElementType<TK1::nTypes-1,typename TK1::types>;
+	  
+	  if constexpr(IC::size==DYNAMIC or IC::size>=NSIMD_COMPONENTS<FundTypeOf<_Ref1>,B>)
+	    return
+	      TK1::nTypes-1;
+	  else
+	    if constexpr(TK1::nDynamic>0)
+	      return
+		TK1::DynCompsPos::last;
+	    else
+	      return
+		NOT_PRESENT;
+	}
+    }
+    
+    /// Check whether the assignment can be vectorized with backend B
+    ///
+    /// The l.h.s must be storing and both sides must be evaluable on
+    /// SIMD packs of the same fundamental type, along the component
+    /// returned by \c posOfVectorizedComp.
+    template <SIMDBackend B>  // SIMD backend
+    static constexpr bool isVectorizable()
+    {
+      return
+	SUNphi::isStoring<RemRef<_Ref1>> and
+	SUNphi::canEvalSIMD<RemRef<_Ref1>> and
+	SUNphi::canEvalSIMD<RemRef<_Ref2>> and
+	isSame<Unqualified<FundTypeOf<_Ref1>>,Unqualified<FundTypeOf<_Ref2>>> and
+	posOfVectorizedComp<B>()!=NOT_PRESENT;
+    }
+    
+  private:
+    
+    /// Evaluates the r.h.s on a SIMD pack along VC, passing the components of the l.h.s by name
+    template <typename VC,        // Component to vectorize
+	      SIMDBackend B,      // SIMD backend
+	      int...Pos,          // Position of the r.h.s components among the l.h.s ones
+	      typename...Args>    // Type of the components
+    DECLAUTO evalRhsSIMDByCompsName(IntSeq<Pos...>,
+				    const Args&...args)  ///< Components of the l.h.s
+      const
+    {
+      return
+	ref2.template evalSIMD<VC,B>(get<Pos>(std::forward_as_tuple(args...))...);
+    }
+    
+    /// Assigns a pack of elements along the vectorized component
+    ///
+    /// The components passed point to the first element of the pack
+    template <SIMDBackend B,      // SIMD backend
+	      typename...Args>    // Type of the components
+    void assignPack(const Args&...args)  ///< Components of the l.h.s
+    {
+      /// Vectorized component
+      using VC=
+	TupleElementType<posOfVectorizedComp<B>(),typename TK1::types>;
+      
+      ref1.template storeSIMD<VC,B>(evalRhsSIMDByCompsName<VC,B>(PosOfRhsTcsInLhsTk{},args...),args...);
+    }
+    
+    /// Loops on the components from the I-th on, inner to the vectorized one, assigning each pack
+    template <int I,              // Component to loop on
+	      SIMDBackend B,      // SIMD backend
+	      typename...Args>    // Type of the outer components
+    void packLoopNest(const Args&...args)  ///< Outer components
+    {
+      if constexpr(I==TK1::nTypes)
+	assignPack<B>(args...);
+      else
+	{
+	  /// Size of the component
+	  const Idx size=
+	    compSize<TupleElementType<I,typename TK1::types>>();
+	  
+	  for(Idx i=0;i<size;i++)
+	    packLoopNest<I+1,B>(args...,i);
+	}
+    }
+    
+    /// Loops on the I-th component by SIMD packs, if it is the vectorized one
+    ///
+    /// The elements not filling a pack are assigned one by one
+    template <int I,              // Component to loop on
+	      SIMDBackend B,      // SIMD backend
+	      typename...Args>    // Type of the outer components
+    void packLoop(const Idx& beg,       ///< Beginning of the range
+		  const Idx& end,       ///< End of the range
+		  const Args&...args)   ///< Outer components
+    {
+      /// Index of the component
+      Idx i=
+	beg;
+      
+      if constexpr(isVectorizable<B>() and I==posOfVectorizedComp<B>())
+	{
+	  /// Number of components of the pack
+	  constexpr Idx nPackComps=
+	    NSIMD_COMPONENTS<Fund,B>;
+	  
+	  for(;i+nPackComps<=end;i+=nPackComps)
+	    packLoopNest<I+1,B>(args...,i);
+	}
+      
+      for(;i<end;i++)
+	loopNest<I+1,B>(args...,i);
+    }
+    
+    /// Loops on the components from the I-th on, assigning each element
+    ///
+    /// The components are looped nested, in the order of the l.h.s.
+    /// If possible, the loop on the vectorized component proceeds by
+    /// SIMD packs, nesting the inner components inside.
+    template <int I,              // Component to loop on
+	      SIMDBackend B,      // SIMD backend
+	      typename...Args>    // Type of the outer components
+    void loopNest(const Args&...args)  ///< Outer components
+    {
+      if constexpr(I==TK1::nTypes)
+	assignElement(args...);
+      else
+	packLoop<I,B>(0,compSize<TupleElementType<I,typename TK1::types>>(),args...);
+    }
+    
+    /// Assigns all elements whose outermost component lies in the range [beg,end)
+    ///
+    /// If the outermost component is also the vectorized one, the
+    /// range is assigned by packs, and the remainder one by one
+    template <SIMDBackend B>  // SIMD backend
+    void assignOuterRange(const Idx& beg,  ///< Beginning of the range
+			  const Idx& end)  ///< End of the range
+    {
+      packLoop<0,B>(beg,end);
+    }
+    
+    /// Total number of elements to be assigned
+    template <int...I>  // Position of the components
+    Idx nElements(IntSeq<I...>)
+      const
+    {
+      return
+	(Idx{1}*...*compSize<TupleElementType<I,typename TK1::types>>());
+    }
+    
   public:
     
     /// Returns the size of a component
     template <typename TC,
 	      typename=ConstrainIsTensComp<TC>>
-    int compSize() const
+    Idx compSize() const
     {
       // Returns the size if it's in the l.h.s \c Tk or in the r.h.s one
-      if constexpr(tupleHasType<TC,TK1>)
+      if constexpr(tupleHasType<TC,typename TK1::types>)
 	 return
 	   ref1.template compSize<TC>();
       else
@@ -102,10 +309,16 @@ namespace SUNphi
     PROVIDE_MERGEABLE_COMPS_ACCORDING_TO_TWO_REFS;
     
     // Returns a component-merged version
-    PROVIDE_GET_MERGED_COMPS_VIEW(/*! Merge appropriately the two references and returns their assignement */,
-    				  return
-				  ref1.template getMergedCompsView<MergedDelims1<Is>>()=
-				  ref2.template getMergedCompsView<MergedDelims2<Is>>(););
+    PROVIDE_GET_MERGED_COMPS_VIEW(/*! Merge appropriately the two references and returns their \c Assigner */,
+				  /* Merged view of the l.h.s */
+				  auto lhsMerged=
+				    ref1.template getMergedCompsView<MergedDelims1<Is>>();
+				  /* Merged view of the r.h.s */
+				  auto rhsMerged=
+				    ref2.template getMergedCompsView<MergedDelims2<Is>>();
+				  
+				  return
+				    Assigner<decltype(lhsMerged),decltype(rhsMerged)>(std::move(lhsMerged),std::move(rhsMerged)););
     
     /// Provides either the const or non-const evaluator
 #define PROVIDE_CONST_OR_NOT_DEFAULT_EVALUATOR(QUALIFIER)		\
@@ -116,7 +329,7 @@ namespace SUNphi
     {									\
       STATIC_ASSERT_ARE_N_TYPES(Tk::nTypes,args);			\
       									\
-      return ref2.eval(forw<Args>(args)...);				\
+      return evalRhsByCompsName(PosOfRhsTcsInLhsTk{},args...);		\
     }
     
     PROVIDE_CONST_OR_NOT_DEFAULT_EVALUATOR(NON_CONST_QUALIF);
@@ -125,8 +338,115 @@ namespace SUNphi
 #undef PROVIDE_CONST_OR_NOT_DEFAULT_EVALUATOR
     
     PROVIDE_BINARY_SMET_SIMPLE_CREATOR(Assigner);
+    
+    /// Performs the assignment
+    ///
+    /// The outermost component is split among the threads of the
+    /// pool, if the pool is waiting for work and the l.h.s is large
+    /// enough to give at least a page to each thread. Otherwise the
+    /// whole loop is executed by the calling thread. Each thread
+    /// dispatches its chunk to the SIMD backend chosen at runtime. If
+    /// the outermost component is also the vectorized one, the chunks
+    /// are made of blocks of as many elements as the widest pack, so
+    /// that each one is filled by packs of any backend.
+    void execute()
+    {
+      if constexpr(TK1::nTypes==0)
+	assignElement();
+      else
+	{
+	  /// Size of the outermost component
+	  const Idx outerSize=
+	    compSize<TupleElementType<0,typename TK1::types>>();
+	  
+	  /// Size of the blocks in which the outermost component is split
+	  constexpr Idx blockSize=
+	    (isVectorizable<SIMDBackend::AVX512>() and posOfVectorizedComp<SIMDBackend::AVX512>()==0)?(ALIGNMENT/sizeof(Fund)):1;
+	  
+	  /// Number of blocks
+	  const Idx nBlocks=
+	    (outerSize+blockSize-1)/blockSize;
+	  
+	  /// Assigns the range of blocks of a chunk with the SIMD backend chosen at runtime
+	  auto assignChunk=
+	    [this,outerSize,blockSize](const LoopChunk<Idx>& chunk)
+	    {
+	      /// Beginning of the range
+	      const Idx beg=
+		chunk.beg*blockSize;
+	      
+	      /// End of the range
+	      const Idx end=
+		std::min(chunk.end*blockSize,outerSize);
+	      
+	      dispatchSIMDBackend([this,beg,end](auto backend)
+				  {
+				    this->template assignOuterRange<decltype(backend)::value>(beg,end);
+				  });
+	    };
+	  
+	  /// Number of threads
+	  const int nThreads=
+	    threads.nActiveThreads();
+	  
+	  /// Check whether to split among the threads
+	  const bool split=
+	    nBlocks>1 and
+	    nThreads>1 and
+	    threads.getIfWaitingForWork() and
+	    threads.isMasterThread() and
+	    Memory::isWorthSplittingAmongThreads(sizeof(Fund)*nElements(IntsUpTo<TK1::nTypes>{}));
+	  
+	  if(split)
+	    threads.workOn([nBlocks,nThreads,&assignChunk](const int& threadId)
+			   {
+			     assignChunk(staticLoopChunk(Idx{0},nBlocks,nThreads,threadId));
+			   });
+	  else
+	    assignChunk({0,nBlocks});
+	}
+    }
   };
   
+  /// \c TensKind of the maximally merged view on which the assignment of \c Rhs to \c Lhs is evaluated
+  template <typename Lhs,  // Type of the l.h.s \c SmET
+	    typename Rhs>  // Type of the r.h.s \c SmET
+  using AssignMergedTk=
+    typename RemRef<decltype(std::declval<Assigner<Lhs,Rhs>&>().getMaximallyMergedCompsView())>::Tk;
+  
+  /// Assigns a \c SmET r.h.s to the l.h.s through an \c Assigner
+  ///
+  /// The \c Assigner is executed on the maximally merged components,
+  /// if any can be merged
+  template <typename Lhs, 	    // Type of the l.h.s \c SmET
+	    typename Rhs> 	    // Type of the r.h.s \c SmET
+  void assignThroughAssigner(Lhs&& lhs,             ///< Left hand side
+			     Rhs&& rhs)             ///< Right hand side
+  {
+    /// Assigner of the r.h.s to the l.h.s
+    Assigner<Lhs,Rhs> assigner(forw<Lhs>(lhs),forw<Rhs>(rhs));
+    
+    /// Check whether no component can be merged
+    constexpr bool noCompMergeable=
+      isSame<typename decltype(assigner)::MergeableComps,IntsUpTo<TkOf<Lhs>::nTypes+1>>;
+    
+    // A single element, or a tensor with no mergeable component, is assigned directly
+    if constexpr(TkOf<Lhs>::nTypes==0 or noCompMergeable)
+      assigner.execute();
+    else
+      {
+	/// Assigner acting on the maximally merged components
+	auto mergedAssigner=
+	  assigner.getMaximallyMergedCompsView();
+	
+#ifdef DEBUG_ASSIGN
+	runLog()<<"Assigning "<<TkOf<Lhs>::name()<<" through "<<decltype(mergedAssigner)::Tk::name();
+#endif
+	
+	mergedAssigner.execute();
+      }
+  }
+  
   /// Default assigner taking only \c SmET as left argument
   ///
   /// \c Rhs can be a \c SmET or not, in which case it is wrapped into a Scalar
@@ -147,59 +467,8 @@ namespace SUNphi
     
     if constexpr(not rhsIsSmET)
       return assign(forw<Lhs>(lhs),scalarWrap(forw<Rhs>(rhs)));
-//     else
-//       {
-	
-// 	if constexpr(TkOf<Lhs>::template contains<TkOf<Rhs>>)
-// 	  {
-// 	    /// Outermost TensComp of rhs
-// 	    using RhsFirstComp=
-// 	      Unqualified<TupleElementType<0,typename TkOf<Rhs>::types>>;
-	
-// 	/// Maximal value reachable from the component
-// 	const int maxEntry=
-// 	  rhs.template compSize<RhsFirstComp>();
-	
-// #ifdef DEBUG_ASSIGN
-// 	using namespace std;
-// 	cout<<" Assign: "<<RhsFirstComp::name()<<" "<<maxEntry;
-// 	cout.flush();
-// 	cout<<", lhs: "<<&lhs;
-// 	cout.flush();
-// 	cout<<", rhs: "<<&rhs;
-// 	cout.flush();
-// 	cout<<", storage1: "<<getStor(lhs)._v;
-// 	cout.flush();
-// 	cout<<", storage2: "<<getStor(rhs)._v;
-// 	cout.flush();
-// 	cout<<endl;
-// #endif
-	
-// 	// Assigns all entries
-// 	for(int i=0;i<maxEntry;i++)
-// 	  bind<RhsFirstComp>(forw<Lhs>(lhs),i)=
-// 	    bind<RhsFirstComp>(forw<Rhs>(rhs),i);
-//       }
-//     else
-//       {
-// 	/// Tens Kind of the lhs expression
-// 	using TKL=
-// 	  typename RemRef<Lhs>::Tk;
-	
-// 	/// Outermost TensComp of lhs
-// 	using LhsFirstComp=
-// 	  Unqualified<TupleElementType<0,typename TKL::types>>;
-	
-// 	/// Maximal value reachable from the component
-// 	const int maxEntry=
-// 	  lhs.template compSize<LhsFirstComp>();
-	
-// 	/// Assigns all entries
-// 	for(int i=0;i<maxEntry;i++)
-// 	  bind<LhsFirstComp>(forw<Lhs>(lhs),i)=
-// 	    rhs;
-//       }
-//  }
+    else
+      assignThroughAssigner(forw<Lhs>(lhs),forw<Rhs>(rhs));
   }
 }
 
@@ -165,6 +165,21 @@ namespace SUNphi
   
   /////////////////////////////////////////////////////////////////
   
+  // Defines the check for a member variable \c canEvalSIMD
+  DEFINE_HAS_MEMBER(canEvalSIMD);
+  
+  /// Provides a \c canEvalSIMD attribute
+  ///
+  /// A \c SmET with this attribute set provides a \c evalSIMD method,
+  /// taking the component to be vectorized as template parameter and
+  /// returning a \c SIMDPack of consecutive values of the component
+#define CAN_EVAL_SIMD_ATTRIBUTE(LONG_DESCRIPTION,...)			\
+  STATIC_CONSTEXPR(/*! Returns whether this \c SmET can be evaluated on a SIMD pack */,LONG_DESCRIPTION,bool,canEvalSIMD,__VA_ARGS__)
+  
+  DEFINE_GETTER_WITH_DEFAULT(canEvalSIMD,false);
+  
+  /////////////////////////////////////////////////////////////////
+  
   /// Provide the MergeableComps type, \c assertMergebaleWith and \c getMaximallyMergedCompsView
   ///
   /// The type must be an ordered \c IntSeq indicating the splitting
@@ -242,10 +257,10 @@ namespace SUNphi
   using PosOfRef ## ID ## PresTcsInResTk=				\
     FilterVariadicClassPos<IsPresent,PosOfRef ## ID ## TcsInResTk>; \
   									\
-  /*! Merged delimiters of Ref ## ID according to MD */			\
+  /*! Merged delimiters of Ref ## ID according to MD, sorted as the ref can be permuted */ \
   template <typename MD> /* Required merging delimiters */		\
   using MergedDelims ## ID=						\
-    IntSeqGetElsAfterAppending<TK ## ID::nTypes,false,MD,PosOfRef ## ID ## TcsInResTk>
+    SortedUniqueIntSeq<IntSeqGetElsAfterAppending<TK ## ID::nTypes,false,MD,PosOfRef ## ID ## TcsInResTk>>
   
   /////////////////////////////////////////////////////////////////
   
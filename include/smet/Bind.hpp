@@ -82,8 +82,12 @@ namespace SUNphi
     public NnarySmET<Binder<TG,_Refs...>>,          // Inherit from \c NnarySmET
     public ConstrainAreSmETs<_Refs...>              // Constrain all \c Refs to be \c SmET
   {
+  public:
+    
     PROVIDE_NNARY_SMET_REFS_AND_CHECK_ARE_N(1);
     
+  private:
+    
     /// Type to get
     using Tg=
       TG;
@@ -124,7 +128,15 @@ namespace SUNphi
     
     PROVIDE_MERGEABLE_COMPS_ACCORDING_TO_REFS_AND_EXTRA;
     
-    PROVIDE_NNARY_GET_MERGED_COMPS_VIEW(/*! Merge the components and create a new \c Binder taking the same component */,return Binder<TG,decltype(MERGED_COMPS_VIEW_OF_REF(0))>(MERGED_COMPS_VIEW_OF_REF(0),id));
+    PROVIDE_NNARY_GET_MERGED_COMPS_VIEW(/*! Merge the components and create a new \c Binder taking the same component */,
+					/* Delimiters of the ref, keeping the bound component alone */
+					using RefMDs=
+					  InsertIntSeqInOrderedIntSeq<IntSeq<pos,pos+1>,TupleElementType<0,MDs>,IntSeq<0,0>,true>;
+					/* Merged view of the ref */
+					auto refMerged=
+					  get<0>(refs).template getMergedCompsView<RefMDs>();
+					
+					return Binder<TG,decltype(refMerged)>(std::move(refMerged),id));
     
     /// Evaluator for Binder
     ///
@@ -182,6 +194,41 @@ namespace SUNphi
     
     // PROVIDE_ALSO_NON_CONST_METHOD(eval);
     
+    CAN_EVAL_SIMD_ATTRIBUTE(/*! Vectorizable if the ref is */,SUNphi::canEvalSIMD<RemRef<Ref<0>>>);
+    
+    /// SIMD evaluator, inserting the id as in \c eval
+    ///
+    /// The bound component is absent in the result, so it cannot be
+    /// the vectorized one
+    template <typename VC,                // Component to vectorize
+	      SIMDBackend B,              // SIMD backend
+	      typename...Args,            // Type of the arguments
+	      int...Head,                 // Position of the first set of args, before insertion
+	      int...Tail>                 // Position of the second set of args, after insertion
+    DECLAUTO binderInternalEvalSIMD(IntSeq<Head...>,              ///< List of position of components before id
+				    IntSeq<Tail...>,              ///< List of position of components after id
+				    const Tuple<Args...>& targs)  ///< Components of the first element
+      const
+    {
+      return get<0>(refs).template evalSIMD<VC,B>(get<Head>(targs)...,
+						id,
+						get<Tail>(targs)...);
+    }
+    
+    /// SIMD evaluator, external interface
+    template <typename VC,                // Component to vectorize
+	      SIMDBackend B,              // SIMD backend
+	      typename...Args>            // Type of the arguments
+    DECLAUTO evalSIMD(const Args&...args)    ///< Components of the first element
+      const
+    {
+      STATIC_ASSERT_ARE_N_TYPES(Tk::nTypes,args);
+      
+      return binderInternalEvalSIMD<VC,B>(IntsUpTo<pos>{},
+					typename IntsUpTo<Tk::nTypes-pos>::template Add<pos>{},
+					std::forward_as_tuple(args...));
+    }
+    
     AS_ASSIGNABLE_AS_REF(0);
     
     PROVIDE_SMET_ASSIGNEMENT_OPERATOR(Binder);
@@ -32,6 +32,13 @@ namespace SUNphi
     constexpr static int posOfCompl=
       posOfType<Compl,typename TkOf<Ref<0>>::types>;
     
+    /// Returns the conjugate of the argument
+    template <typename T>                         // Type of the argument to conjugate
+    static DECLAUTO representativeFunction(T&& t) ///< Argument to conjugate
+    {
+      return conj(forw<T>(t));
+    }
+    
     PROVIDE_SIMPLE_NNARY_COMP_SIZE;
     
     // Attributes
@@ -73,6 +80,45 @@ namespace SUNphi
       else
       	return +val;
     }
+    
+    CAN_EVAL_SIMD_ATTRIBUTE(/*! Vectorizable if the ref is */,SUNphi::canEvalSIMD<RemRef<Ref<0>>>);
+    
+    /// SIMD evaluator for \c Conjer
+    ///
+    /// The \c Compl component is never merged. If it is the
+    /// vectorized one, the pack contains interleaved complex numbers,
+    /// otherwise the sign is the same for the whole pack
+    template <typename VC,          // Component to vectorize
+	      SIMDBackend B,        // SIMD backend
+	      typename...Args>      // Type of the arguments
+    auto evalSIMD(const Args&...args)    //!< Components of the first element
+      const
+    {
+      if constexpr(isSame<VC,Compl>)
+	{
+	  /// Pack of interleaved complex numbers
+	  const auto val=
+	    get<0>(refs).template evalSIMD<VC,B>(args...);
+      
+	  return
+	    conj(val);
+	}
+      else
+	{
+      /// Detect if we have to put "-" in the result
+      const bool isIm=
+	get<posOfCompl>(std::forward_as_tuple(args...));
+      
+      /// Temporary result
+      auto val=
+	get<0>(refs).template evalSIMD<VC,B>(args...);
+      
+      if(isIm)
+      	return -val;
+      else
+      	return +val;
+	}
+    }
   };
   
   // Check that a test Conjer is a NnarySmET
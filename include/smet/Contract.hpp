@@ -0,0 +1,1060 @@
+#ifndef _CONTRACT_HPP
+#define _CONTRACT_HPP
+
+/// \file Contract.hpp
+///
+/// \brief Defines a class which contracts two \c SmET along twinned components
+///
+/// Each column component of the first factor is contracted with the
+/// row twin of the second factor, giving the matrix-matrix
+/// product. If the second factor has no row twin, as for a vector,
+/// the column component of the second factor is contracted instead,
+/// and the row component of the first factor takes the name of the
+/// column one in the result, giving the matrix-vector product. All
+/// other components are taken by name, so that the product is
+/// broadcast over them, such as the \c Spacetime component of a
+/// field of links. If both factors contain the \c Compl component,
+/// the product is the complex one.
+///
+/// The contracted components are summed by nested loops, unrolled at
+/// compile time for small static sizes. A contraction along a dynamic
+/// component is assigned in tiles of the outermost component of the
+/// result: each tile is accumulated in blocks of the first dynamic
+/// contracted component on a temporary small enough to stay in
+/// cache, together with the part of the factors involved in a block,
+/// and then written once to the l.h.s. If the l.h.s aliases one of
+/// the factors, as in \c u=u*v, the contraction is evaluated on a
+/// temporary, also when it is nested in a larger expression, as in \c
+/// u=u*v+w.
+
+#include <algorithm>
+
+#include <containers/Vector.hpp>
+#include <physics/Compl.hpp>
+#include <smet/Add.hpp>
+#include <smet/Assign.hpp>
+#include <smet/Reference.hpp>
+#include <smet/NnarySmET.hpp>
+#include <smet/Transpose.hpp>
+#include <tens/TensKind.hpp>
+#include <tens/TensClass.hpp>
+#include <tens/TwinsComp.hpp>
+
+namespace SUNphi
+{
+  /// Maximal static size of a contracted component for which the loop is unrolled
+  constexpr int MAX_UNROLLED_CONTRACTION_SIZE=
+    16;
+  
+  /// Size of the blocks in which the first dynamic contracted component is split
+  constexpr TensIdx CONTRACTION_BLOCK_SIZE=
+    64;
+  
+  /// Size in bytes of the tile of the result accumulated across the blocks
+  constexpr size_t CONTRACTION_TILE_SIZE=
+    1<<15;
+  
+  /// Structure of the contraction of two \c TensKind
+  ///
+  /// Forward declaration
+  template <typename Tk1,   // \c TensKind of the first factor
+	    typename Tk2>   // \c TensKind of the second factor
+  struct ContractionOfTensKinds;
+  
+  /// Structure of the contraction of two \c TensKind
+  ///
+  /// The column component of the second factor takes the place of
+  /// the contracted one in the result, and the components present
+  /// only in the second factor are appended
+  template <typename...T1,  // Types of the first \c TensKind
+	    typename...T2>  // Types of the second \c TensKind
+  struct ContractionOfTensKinds<TensKind<T1...>,TensKind<T2...>>
+  {
+    /// Types of the first \c TensKind
+    using Types1=
+      Tuple<T1...>;
+    
+    /// Types of the second \c TensKind
+    using Types2=
+      Tuple<T2...>;
+    
+    /// Check whether the component \c T of the first factor is contracted
+    template <typename T>
+    static constexpr bool isContractedIn1=
+      isCnTensComp<T> and
+      tupleHasType<T,Types1> and
+      (tupleHasType<TwinCompOf<T>,Types2> or tupleHasType<T,Types2>);
+    
+    /// Check whether the component \c T of the first factor takes the name of its twin in the result
+    template <typename T>
+    static constexpr bool isRenamedIn1=
+      hasTwin<T> and
+      (not isCnTensComp<T>) and
+      tupleHasType<T,Types1> and
+      isContractedIn1<TwinCompOf<T>> and
+      (not tupleHasType<T,Types2>);
+    
+    /// Check whether the component \c T of the second factor is contracted
+    template <typename T>
+    static constexpr bool isContractedIn2=
+      hasTwin<T> and
+      tupleHasType<T,Types2> and
+      (isCnTensComp<T>?
+       (isContractedIn1<T> and not tupleHasType<TwinCompOf<T>,Types2>):
+       isContractedIn1<TwinCompOf<T>>);
+    
+    /// Contracted components, named as in the first factor
+    using ContractedComps=
+      TupleTypeCatT<Conditional<isContractedIn1<T1>,Tuple<T1>,Tuple<>>...>;
+    
+    /// Component of the second factor contracted with the component \c T of the first one
+    template <typename T>
+    using ContractedCompIn2=
+      Conditional<tupleHasType<TwinCompOf<T>,Types2>,TwinCompOf<T>,T>;
+    
+    /// Number of contracted components
+    static constexpr int nContracted=
+      tupleSize<ContractedComps>;
+    
+    /// Components of the result in place of the component \c T of the first factor
+    template <typename T>
+    using ResCompsOf1=
+      Conditional<isContractedIn1<T>,
+		  Conditional<tupleHasType<T,Types2> and not isContractedIn2<T>,Tuple<T>,Tuple<>>,
+		  Conditional<isRenamedIn1<T>,Tuple<TwinCompOf<T>>,Tuple<T>>>;
+    
+    /// Components of the result coming from the first factor
+    using ResTypesFrom1=
+      TupleTypeCatT<ResCompsOf1<T1>...>;
+    
+    /// Components of the result
+    using ResTypes=
+      TupleTypeCatT<ResTypesFrom1,
+		    Conditional<isContractedIn2<T2> or tupleHasType<T2,ResTypesFrom1>,Tuple<>,Tuple<T2>>...>;
+    
+    /// \c TensKind of the result
+    using Tk=
+      TensKindFromTuple<ResTypes>;
+    
+    /// Position of the components of the first factor in the list of contracted and result components
+    using PosOfComps1=
+      IntSeq<(isContractedIn1<T1>?
+	      posOfTypeNotAsserting<T1,ContractedComps>:
+	      (nContracted+posOfTypeNotAsserting<Conditional<isRenamedIn1<T1>,TwinCompOf<T1>,T1>,ResTypes>))...>;
+    
+    /// Position of the components of the second factor in the list of contracted and result components
+    using PosOfComps2=
+      IntSeq<(isContractedIn2<T2>?
+	      posOfTypeNotAsserting<Conditional<isCnTensComp<T2>,T2,TwinCompOf<T2>>,ContractedComps>:
+	      (nContracted+posOfTypeNotAsserting<T2,ResTypes>))...>;
+    
+    /// Component of the first factor corresponding to the component \c TC of the result
+    template <typename TC>
+    using SourceCompIn1=
+      Conditional<isRenamedIn1<TwinCompOf<TC>>,TwinCompOf<TC>,TC>;
+    
+    /// Check whether the component \c TC of the result is taken from the first factor
+    template <typename TC>
+    static constexpr bool resDependsOn1=
+      tupleHasType<SourceCompIn1<TC>,Types1> and
+      not isContractedIn1<SourceCompIn1<TC>>;
+    
+    /// Check whether the component \c TC of the result is taken from the second factor
+    template <typename TC>
+    static constexpr bool resDependsOn2=
+      tupleHasType<TC,Types2> and
+      not isContractedIn2<TC>;
+    
+    /// Position in the first factor of the first dynamic contracted component
+    static constexpr int posOfFirstDynContractedIn1=
+      firstEq<1,(isContractedIn1<T1> and T1::isDynamic)...>;
+    
+    /// Check whether a contracted component is dynamic
+    static constexpr bool hasDynContracted=
+      (posOfFirstDynContractedIn1!=sizeof...(T1));
+    
+    /// Position among the contracted components of the first dynamic one
+    static constexpr int posOfFirstDynContracted=
+      hasDynContracted?
+      hSumFirst<posOfFirstDynContractedIn1,isContractedIn1<T1>...>:
+      NOT_PRESENT;
+  };
+  
+  /// Returns a tensor with the kind and sizes of a \c SmET
+  ///
+  /// Internal implementation
+  template <typename T,    // Type of the \c SmET
+	    int...DynPos>  // Position of the dynamic components
+  auto _tensWithSizesOf(const T& smet,            ///< \c SmET whose sizes are taken
+			const IntSeq<DynPos...>&)
+  {
+    return
+      Tens<TkOf<T>,Unqualified<FundTypeOf<T>>>(smet.template compSize<TupleElementType<DynPos,typename TkOf<T>::types>>()...);
+  }
+  
+  /// Returns a tensor with the kind and sizes of a \c SmET
+  ///
+  /// Used to evaluate an expression on a temporary
+  template <typename T>    // Type of the \c SmET
+  auto tensWithSizesOf(const T& smet)  ///< \c SmET whose sizes are taken
+  {
+    return
+      _tensWithSizesOf(smet,typename TkOf<T>::DynCompsPos{});
+  }
+  
+  // Base type to qualify as Contracter
+  DEFINE_BASE_TYPE(Contracter);
+  
+  /// Class to contract two \c SmET along the twinned components
+  template <typename..._Refs>                    // Reference types
+  class Contracter :
+    public BaseContracter,                       // Inherit from \c BaseContracter to detect in expression
+    public NnarySmET<Contracter<_Refs...>>,      // Inherit from \c NnarySmET
+    public ConstrainAreSmETs<_Refs...>           // Constrain all \c Refs to be \c SmET
+  {
+  public:
+    
+    PROVIDE_NNARY_SMET_REFS_AND_CHECK_ARE_N(2);
+    
+    /// Position of the elements
+    enum Pos_t{FACT1,
+	       FACT2};
+    
+    /// Structure of the contraction
+    using Contraction=
+      ContractionOfTensKinds<TkOf<Ref<FACT1>>,TkOf<Ref<FACT2>>>;
+    
+    /// Contracted components, named as in the first factor
+    using ContractedComps=
+      typename Contraction::ContractedComps;
+    
+    /// Number of contracted components
+    static constexpr int nContracted=
+      Contraction::nContracted;
+    
+    /// Position of the components of each factor in the list of contracted and result components
+    using PosOfContractedAndResTcsInRefsTk=
+      Tuple<typename Contraction::PosOfComps1,
+	    typename Contraction::PosOfComps2>;
+    
+    /// Check whether the contraction is split in blocks of a dynamic component
+    static constexpr bool hasBlockedComp=
+      Contraction::hasDynContracted;
+    
+    /// Position among the contracted components of the one split in blocks
+    static constexpr int posOfBlockedComp=
+      Contraction::posOfFirstDynContracted;
+    
+    /// Representative function of the product
+    template <typename Fact1,  // Type of the first factor
+	      typename Fact2>  // Type of the second factor
+    static DECLAUTO representativeFunction(Fact1&& fact1,   ///< First factor
+					   Fact2&& fact2)   ///< Second factor
+    {
+      return fact1*fact2;
+    }
+    
+    // Attributes
+    NOT_STORING;
+    FORWARD_IS_ALIASING_TO_REFS;
+    
+    /// TensorKind of the result
+    PROVIDE_TK(typename Contraction::Tk);
+    
+    PROVIDE_FUND_ACCORDING_TO_REPRESENTATIVE_FUNCTION;
+    
+    /// Check whether the product is the complex one
+    static constexpr bool isComplProduct=
+      isComplTensKind<TkOf<Ref<FACT1>>> and
+      isComplTensKind<TkOf<Ref<FACT2>>>;
+    
+    /// Position of the \c Compl component in the result
+    static constexpr int posOfCompl=
+      posOfTypeNotAsserting<Compl,typename Tk::types>;
+    
+    static_assert(not isComplProduct or posOfCompl!=NOT_PRESENT,"The Compl component of a complex product cannot be merged");
+    
+    /// Check whether the outermost component of the result is dynamic, so that the result can be split in tiles of it
+    static constexpr bool hasDynOuterComp=
+      Tk::DynCompsPos::template has<0>;
+    
+    PROVIDE_MERGEABLE_COMPS(/*! The contracted components are summed inside the evaluation, so no component is merged */,
+			    IntsUpTo<Tk::nTypes+1>);
+    
+    PROVIDE_GET_MERGED_COMPS_VIEW(/*! Returns the \c Contracter itself */,
+				  return *this);
+  
+  private:
+    
+    /// Beginning of the range of the blocked component
+    TensIdx blockedBeg;
+    
+    /// End of the range of the blocked component
+    TensIdx blockedEnd;
+    
+    /// Beginning of the range of the outermost component of the result
+    TensIdx outerBeg;
+    
+    /// End of the range of the outermost component of the result
+    TensIdx outerEnd;
+    
+    /// Evaluates the I-th factor
+    ///
+    /// The contracted components \c ks are passed ahead of the
+    /// components of the result contained in the \c Tuple \c targs
+    template <int I,          // Factor to evaluate
+	      typename Tp,    // Type of the \c Tuple containing the components of the result
+	      typename...Ks>  // Type of the contracted components
+    DECLAUTO factEval(const Tp& targs,     ///< Components of the result
+		      const Ks&...ks)      ///< Contracted components
+      const
+    {
+      return
+	this->_refEvalByCompsName(IntSeq<I>{},
+				  TupleElementType<I,PosOfContractedAndResTcsInRefsTk>{},
+				  std::tuple_cat(std::forward_as_tuple(ks...),targs));
+    }
+    
+    /// Evaluates the I-th factor on a SIMD pack along the component \c VC of the result
+    ///
+    /// If the factor does not depend on \c VC, the element is broadcast
+    template <typename VC,    // Component to vectorize
+	      SIMDBackend B,  // SIMD backend
+	      int I,          // Factor to evaluate
+	      typename Tp,    // Type of the \c Tuple containing the components of the result
+	      typename...Ks>  // Type of the contracted components
+    SIMDPack<Fund,B> factEvalSIMD(const Tp& targs,     ///< Components of the first element of the result
+				  const Ks&...ks)      ///< Contracted components
+      const
+    {
+      /// Check whether the factor depends on \c VC
+      constexpr bool dependsOnVC=
+	(I==FACT1)?
+	Contraction::template resDependsOn1<VC>:
+	Contraction::template resDependsOn2<VC>;
+      
+      /// Component of the factor to vectorize
+      using RefVC=
+	Conditional<I==FACT1,typename Contraction::template SourceCompIn1<VC>,VC>;
+      
+      if constexpr(dependsOnVC)
+	return
+	  this->template _refEvalSIMDByCompsName<RefVC,B>(IntSeq<I>{},
+							  TupleElementType<I,PosOfContractedAndResTcsInRefsTk>{},
+							  std::tuple_cat(std::forward_as_tuple(ks...),targs));
+      else
+	return
+	  SIMDPack<Fund,B>::broadcast(factEval<I>(targs,ks...));
+    }
+    
+    /// Crashes if the size of component \c C1 of the first factor differs from the one of \c C2 of the second
+    template <typename C1,  // Component of the first factor
+	      typename C2>  // Component of the second factor
+    void assertSameCompSize()
+      const
+    {
+      /// Size in the first factor
+      const TensIdx size1=
+	get<FACT1>(refs).template compSize<C1>();
+      
+      /// Size in the second factor
+      const TensIdx size2=
+	get<FACT2>(refs).template compSize<C2>();
+      
+      if(size1!=size2)
+	CRASH<<"Size "<<size1<<" of a component of the first factor does not match size "<<size2<<" of the second one";
+    }
+    
+    /// Crashes if the sizes of the dynamic contracted components differ in the two factors
+    template <int I=0>  // Contracted component to check
+    void assertContractedSizesMatch()
+      const
+    {
+      if constexpr(I<nContracted)
+	{
+	  /// Contracted component
+	  using C=
+	    TupleElementType<I,ContractedComps>;
+	  
+	  if constexpr(C::isDynamic)
+	    assertSameCompSize<C,typename Contraction::template ContractedCompIn2<C>>();
+	  
+	  assertContractedSizesMatch<I+1>();
+	}
+    }
+    
+    /// Crashes if the sizes of the dynamic components of the result taken from both factors differ
+    template <int I=0>  // Component of the result to check
+    void assertSharedSizesMatch()
+      const
+    {
+      if constexpr(I<Tk::nTypes)
+	{
+	  /// Component of the result
+	  using TC=
+	    TupleElementType<I,typename Tk::types>;
+	  
+	  if constexpr(TC::isDynamic and
+		       Contraction::template resDependsOn1<TC> and
+		       Contraction::template resDependsOn2<TC>)
+	    assertSameCompSize<typename Contraction::template SourceCompIn1<TC>,TC>();
+	  
+	  assertSharedSizesMatch<I+1>();
+	}
+    }
+    
+    /// Returns the size of the I-th contracted component
+    template <int I>  // Contracted component
+    TensIdx contractedCompSize()
+      const
+    {
+      return
+	get<FACT1>(refs).template compSize<TupleElementType<I,ContractedComps>>();
+    }
+    
+    /// Loops on the contracted components from the I-th on, calling \c f with all of them
+    ///
+    /// Small static components are unrolled, the blocked one is
+    /// restricted to the current block
+    template <int I,          // Contracted component to loop on
+	      typename F,     // Type of the function to call
+	      typename...Ks>  // Type of the outer contracted components
+    void loopOnContracted(const F& f,       ///< Function to call
+			  const Ks&...ks)   ///< Outer contracted components
+      const
+    {
+      if constexpr(I==nContracted)
+	f(ks...);
+      else
+	{
+	  /// Contracted component
+	  using C=
+	    TupleElementType<I,ContractedComps>;
+	  
+	  if constexpr((not C::isDynamic) and C::size<=MAX_UNROLLED_CONTRACTION_SIZE)
+	    unrolledLoopOnContracted<I>(IntsUpTo<C::size>{},f,ks...);
+	  else
+	    {
+	      /// Beginning of the loop
+	      const TensIdx beg=
+		(I==posOfBlockedComp)?blockedBeg:0;
+	      
+	      /// End of the loop
+	      const TensIdx end=
+		(I==posOfBlockedComp)?blockedEnd:contractedCompSize<I>();
+	      
+	      for(TensIdx k=beg;k<end;k++)
+		loopOnContracted<I+1>(f,ks...,k);
+	    }
+	}
+    }
+    
+    /// Unrolls the loop on the I-th contracted component
+    template <int I,          // Contracted component to loop on
+	      int...K,        // Values of the component
+	      typename F,     // Type of the function to call
+	      typename...Ks>  // Type of the outer contracted components
+    void unrolledLoopOnContracted(IntSeq<K...>,
+				  const F& f,       ///< Function to call
+				  const Ks&...ks)   ///< Outer contracted components
+      const
+    {
+      (loopOnContracted<I+1>(f,ks...,TensIdx{K}),...);
+    }
+    
+    /// Components of the real and imaginary part of the passed ones
+    ///
+    /// The real part is the first element of the returned \c Tuple,
+    /// the imaginary one the second
+    template <typename Tp>    // Type of the \c Tuple containing the components
+    static auto reImComps(const Tp& targs)  ///< Components to get
+    {
+      /// Components pointing to the real part
+      Tp re=
+	targs;
+      
+      /// Components pointing to the imaginary part
+      Tp im=
+	targs;
+      
+      get<posOfCompl>(re)=
+	0;
+      
+      get<posOfCompl>(im)=
+	1;
+      
+      return
+	std::make_tuple(re,im);
+    }
+  
+    /// Returns the size of a component, disregarding the restriction to a range
+    ///
+    /// The size is taken from the factor from which the component of
+    /// the result comes
+    template <typename TC>  // Component to get
+    TensIdx fullCompSize() const
+    {
+      if constexpr(Contraction::template resDependsOn1<TC>)
+	return
+	  get<FACT1>(refs).template compSize<typename Contraction::template SourceCompIn1<TC>>();
+      else
+	return
+	  get<FACT2>(refs).template compSize<TC>();
+    }
+    
+    /// Components of the result, with the outermost one shifted to the beginning of its range
+    template <typename...Args>    // Type of the arguments
+    Tuple<Args...> shiftedComps(const Args&...args)  ///< Components to get
+      const
+    {
+      /// Shifted components
+      Tuple<Args...> targs(args...);
+      
+      if constexpr(hasDynOuterComp)
+	get<0>(targs)+=
+	  outerBeg;
+      
+      return
+	targs;
+    }
+    
+    /// Number of elements of the result for each value of the outermost component
+    ///
+    /// Internal implementation
+    template <int...I>  // Position of the components
+    TensIdx _outerCompSliceSize(const IntSeq<I...>&)
+      const
+    {
+      return
+	(TensIdx{1}*...*((I==0)?1:compSize<TupleElementType<I,typename Tk::types>>()));
+    }
+    
+  public:
+    
+    /// Returns the size of a component
+    ///
+    /// The outermost component is restricted to its range
+    template <typename TC>  // Component to get
+    TensIdx compSize() const
+    {
+      if constexpr(hasDynOuterComp and isSame<TC,TupleElementType<0,typename Tk::types>>)
+	return
+	  outerEnd-outerBeg;
+      else
+	return
+	  fullCompSize<TC>();
+    }
+    
+    /// Number of elements of the result for each value of the outermost component
+    TensIdx outerCompSliceSize()
+      const
+    {
+      return
+	_outerCompSliceSize(IntsUpTo<Tk::nTypes>{});
+    }
+    
+    /// Returns a tensor with the kind and sizes of the result
+    ///
+    /// Used to evaluate the contraction when the l.h.s aliases one of
+    /// the factors
+    auto resultTens()
+      const
+    {
+      return
+	tensWithSizesOf(*this);
+    }
+    
+    /// Returns the size of the component split in blocks
+    TensIdx blockedCompSize()
+      const
+    {
+      return
+	contractedCompSize<posOfBlockedComp>();
+    }
+    
+    /// Returns a copy in which the blocked component is restricted to the range [beg,end)
+    Contracter restrictedToBlock(const TensIdx& beg,  ///< Beginning of the block
+				 const TensIdx& end)  ///< End of the block
+      const
+    {
+      /// Returned copy
+      Contracter out=
+	*this;
+      
+      out.blockedBeg=
+	beg;
+      
+      out.blockedEnd=
+	end;
+      
+      return
+	out;
+    }
+    
+    /// Returns a copy in which the outermost component of the result is restricted to the range [beg,end)
+    ///
+    /// The element \c i of the outermost component of the copy is
+    /// the element \c beg+i of the original one
+    Contracter restrictedToOuterRange(const TensIdx& beg,  ///< Beginning of the range
+				      const TensIdx& end)  ///< End of the range
+      const
+    {
+      static_assert(hasDynOuterComp,"Only a dynamic outermost component can be restricted");
+      
+      /// Returned copy
+      Contracter out=
+	*this;
+      
+      out.outerBeg=
+	outerBeg+beg;
+      
+      out.outerEnd=
+	outerBeg+end;
+      
+      return
+	out;
+    }
+    
+    /// Evaluator for \c Contracter
+    ///
+    /// The product of the factors is summed over the contracted
+    /// components. The real and imaginary part of the factors are
+    /// evaluated separately for the complex product.
+    template <typename...Args>    // Type of the arguments
+    Fund eval(const Args&...args)    ///< Components to get
+      const
+    {
+      STATIC_ASSERT_ARE_N_TYPES(Tk::nTypes,args);
+      
+      /// Result
+      Fund res=
+	0;
+      
+      if constexpr(not isComplProduct)
+	{
+	  /// Components of the result
+	  const auto targs=
+	    shiftedComps(args...);
+	  
+	  loopOnContracted<0>([this,&targs,&res](const auto&...ks)
+			      {
+				res+=
+				  factEval<FACT1>(targs,ks...)*
+				  factEval<FACT2>(targs,ks...);
+			      });
+	}
+      else
+	{
+	  /// Components of the real and imaginary parts
+	  const auto [re,im]=
+	    reImComps(shiftedComps(args...));
+	  
+	  /// Check whether the imaginary part is asked
+	  const bool isIm=
+	    get<posOfCompl>(std::forward_as_tuple(args...));
+	  
+	  loopOnContracted<0>([this,&re=re,&im=im,isIm,&res](const auto&...ks)
+			      {
+				/// Real part of the first factor
+				const auto fact1Re=
+				  factEval<FACT1>(re,ks...);
+				
+				/// Imaginary part of the first factor
+				const auto fact1Im=
+				  factEval<FACT1>(im,ks...);
+				
+				/// Real part of the second factor
+				const auto fact2Re=
+				  factEval<FACT2>(re,ks...);
+				
+				/// Imaginary part of the second factor
+				const auto fact2Im=
+				  factEval<FACT2>(im,ks...);
+				
+				if(isIm)
+				  res+=
+				    fact1Re*fact2Im+fact1Im*fact2Re;
+				else
+				  res+=
+				    fact1Re*fact2Re-fact1Im*fact2Im;
+			      });
+	}
+      
+      return
+	res;
+    }
+    
+    PROVIDE_ALSO_NON_CONST_METHOD(eval);
+    
+    CAN_EVAL_SIMD_ATTRIBUTE(/*! Vectorizable if all refs are */,
+			    ((SUNphi::canEvalSIMD<RemRef<_Refs>> and
+			      isSame<Unqualified<typename RemRef<_Refs>::Fund>,Unqualified<Fund>>) && ...));
+    
+    /// SIMD evaluator for \c Contracter, using fused multiply-add
+    ///
+    /// If the vectorized component is \c Compl, each pack contains
+    /// interleaved complex numbers, multiplied with \c
+    /// complFma. Otherwise, in the complex case, real and imaginary
+    /// parts are evaluated on separate packs.
+    template <typename VC,          // Component to vectorize
+	      SIMDBackend B,        // SIMD backend
+	      typename...Args>      // Type of the arguments
+    SIMDPack<Fund,B> evalSIMD(const Args&...args)    ///< Components of the first element
+      const
+    {
+      STATIC_ASSERT_ARE_N_TYPES(Tk::nTypes,args);
+      
+      /// Result
+      SIMDPack<Fund,B> res=
+	SIMDPack<Fund,B>::broadcast(0);
+      
+      if constexpr(not isComplProduct or isSame<VC,Compl>)
+	{
+	  /// Components of the result
+	  const auto targs=
+	    shiftedComps(args...);
+	  
+	  loopOnContracted<0>([this,&targs,&res](const auto&...ks)
+			      {
+				/// First factor
+				const SIMDPack<Fund,B> fact1=
+				  factEvalSIMD<VC,B,FACT1>(targs,ks...);
+				
+				/// Second factor
+				const SIMDPack<Fund,B> fact2=
+				  factEvalSIMD<VC,B,FACT2>(targs,ks...);
+				
+				if constexpr(isComplProduct)
+				  res=
+				    complFma(fact1,fact2,res);
+				else
+				  res=
+				    fma(fact1,fact2,res);
+			      });
+	}
+      else
+	{
+	  /// Components of the real and imaginary parts
+	  const auto [re,im]=
+	    reImComps(shiftedComps(args...));
+	  
+	  /// Check whether the imaginary part is asked
+	  const bool isIm=
+	    get<posOfCompl>(std::forward_as_tuple(args...));
+	  
+	  loopOnContracted<0>([this,&re=re,&im=im,isIm,&res](const auto&...ks)
+			      {
+				/// Real part of the first factor
+				const SIMDPack<Fund,B> fact1Re=
+				  factEvalSIMD<VC,B,FACT1>(re,ks...);
+				
+				/// Imaginary part of the first factor
+				const SIMDPack<Fund,B> fact1Im=
+				  factEvalSIMD<VC,B,FACT1>(im,ks...);
+				
+				/// Real part of the second factor
+				const SIMDPack<Fund,B> fact2Re=
+				  factEvalSIMD<VC,B,FACT2>(re,ks...);
+				
+				/// Imaginary part of the second factor
+				const SIMDPack<Fund,B> fact2Im=
+				  factEvalSIMD<VC,B,FACT2>(im,ks...);
+				
+				if(isIm)
+				  res=
+				    fma(fact1Re,fact2Im,fma(fact1Im,fact2Re,res));
+				else
+				  res=
+				    fma(fact1Re,fact2Re,fma(-fact1Im,fact2Im,res));
+			      });
+	}
+      
+      return
+	res;
+    }
+    
+    /// Constructor taking universal reference
+    ///
+    /// The sizes of the dynamic components found in both factors are
+    /// checked to match. The blocked component and the outermost
+    /// component of the result, if dynamic, are taken in their full
+    /// range.
+    template <typename...SMETS,
+	      typename=EnableIf<((isSame<Unqualified<SMETS>,Unqualified<_Refs>>) && ...)>>
+    explicit Contracter(SMETS&&...smets) :   ///< Factors
+      refs(forw<SMETS>(smets)...),
+      blockedBeg(0),
+      blockedEnd(0),
+      outerBeg(0),
+      outerEnd(0)
+    {
+      assertContractedSizesMatch();
+      
+      assertSharedSizesMatch();
+      
+      if constexpr(hasBlockedComp)
+	blockedEnd=
+	  blockedCompSize();
+      
+      if constexpr(hasDynOuterComp)
+	outerEnd=
+	  fullCompSize<TupleElementType<0,typename Tk::types>>();
+    }
+  };
+  
+  // Check that a test Contracter is a NnarySmET
+  namespace CheckContracterIsNnarySmet
+  {
+    /// Tensor comp for test
+    using MyTc=
+      TensComp<double,1>;
+    
+    /// Tensor kind to be tested
+    using MyTk=
+      TensKind<MyTc>;
+    
+    /// Tensor to be tested
+    using MyT=
+      Tens<MyTk,double>;
+    
+    STATIC_ASSERT_IS_NNARY_SMET(Contracter<MyT,MyT>);
+  }
+  
+  // Build Contracter from contract
+  SIMPLE_NNARY_SMET_BUILDER(contract,Contracter);
+  
+  /// Implement smet1*smet2 as the contraction of the two
+  template <typename T1,              // Type of the first expression
+	    typename T2,              // Type of the second expression
+	    SFINAE_ON_TEMPLATE_ARG(isSmET<T1> and isSmET<T2>)>
+  DECLAUTO operator*(T1&& smet1,      ///< First factor
+		     T2&& smet2)      ///< Second factor
+  {
+    return contract(forw<T1>(smet1),forw<T2>(smet2));
+  }
+  
+  /// Check whether the \c SmET \c T contains a contraction
+  ///
+  /// Forward declaration
+  template <typename T>  // Type to check
+  constexpr bool containsContracter();
+  
+  /// Check whether any of the references contains a contraction
+  template <typename...Refs>  // Type of the references
+  constexpr bool anyContainsContracter(Tuple<Refs...>*)
+  {
+    return
+      (containsContracter<Refs>() or ...);
+  }
+  
+  /// Check whether the \c SmET \c T contains a contraction
+  ///
+  /// The references are searched recursively
+  template <typename T>  // Type to check
+  constexpr bool containsContracter()
+  {
+    if constexpr(isContracter<T>)
+      return
+	true;
+    else
+      if constexpr(isNnarySmET<T> and not isTens<T>)
+	return
+	  anyContainsContracter(static_cast<typename RemRef<T>::Refs*>(nullptr));
+      else
+	return
+	  false;
+  }
+  
+  /// Check whether a contraction contained in the \c SmET aliases the passed storage
+  ///
+  /// Only the contractions are searched, as the other \c SmET
+  /// evaluate each element of the l.h.s from the same element of
+  /// the factors
+  template <typename T,       // Type of the \c SmET
+	    typename Tref>    // Type of the storage
+  bool isContractionAliasing(const T& smet,       ///< \c SmET to be searched
+			     const Tref& alias)   ///< Storage to be checked
+  {
+    if constexpr(isContracter<T>)
+      return
+	smet.isAliasing(alias);
+    else
+      if constexpr(isNnarySmET<T> and not isTens<T>)
+	{
+	  /// Result
+	  bool res=
+	    false;
+	  
+	  forEach(smet.refs,[&res,&alias](const auto& ref)
+			    {
+			      res|=
+				isContractionAliasing(ref,alias);
+			    });
+	  
+	  return
+	    res;
+	}
+      else
+	return
+	  false;
+  }
+  
+  /// Check whether the contraction \c Rhs can be assigned to \c Lhs in tiles of the outermost component
+  ///
+  /// The l.h.s must be a tensor whose outermost component is the
+  /// dynamic outermost component of the result
+  template <typename Lhs,   // Type of the l.h.s
+	    typename Rhs>   // Type of the r.h.s \c Contracter
+  constexpr bool canAssignContractionInTiles()
+  {
+    if constexpr(isTens<Lhs> and RemRef<Rhs>::hasDynOuterComp)
+      return
+	isSame<TupleElementType<0,typename TkOf<Lhs>::types>,
+	       TupleElementType<0,typename TkOf<Rhs>::types>>;
+    else
+      return
+	false;
+  }
+  
+  /// Assigns a contraction split in blocks, in tiles of the outermost component
+  ///
+  /// Each tile of the result is accumulated across the blocks on a
+  /// temporary tensor of the thread, small enough to stay in cache,
+  /// and then copied to the l.h.s, so that each element of the l.h.s
+  /// is written once. The tiles are split among the threads.
+  template <typename Lhs, 	    // Type of the l.h.s \c Tens
+	    typename Rhs> 	    // Type of the r.h.s \c Contracter
+  void assignContractionInTiles(Lhs&& lhs,             ///< Left hand side
+				const Rhs& rhs)        ///< Right hand side, contraction to assign
+  {
+    /// Outermost component of the result
+    using OC=
+      TupleElementType<0,typename TkOf<Rhs>::types>;
+    
+    /// Size of the outermost component
+    const TensIdx outerSize=
+      rhs.template compSize<OC>();
+    
+    /// Size of the blocked component
+    const TensIdx size=
+      rhs.blockedCompSize();
+    
+    /// Number of values of the outermost component in each tile
+    const TensIdx tileSize=
+      std::clamp<TensIdx>(CONTRACTION_TILE_SIZE/(sizeof(FundTypeOf<Rhs>)*std::max<TensIdx>(rhs.outerCompSliceSize(),1)),1,std::max<TensIdx>(outerSize,1));
+    
+    /// Number of tiles
+    const TensIdx nTiles=
+      (outerSize+tileSize-1)/tileSize;
+    
+    /// Temporary accumulation tensors, one per thread
+    Vector<decltype(rhs.resultTens())> accs;
+    for(int threadId=0;threadId<threads.nActiveThreads();threadId++)
+      accs.push_back(rhs.restrictedToOuterRange(0,tileSize).resultTens());
+    
+    Memory::onThreadsChunks(nTiles,[&lhs,&rhs,&accs,outerSize,size,tileSize](const int& threadId,const LoopChunk<size_t>& chunk)
+			    {
+			      for(TensIdx iTile=chunk.beg;iTile<(TensIdx)chunk.end;iTile++)
+				{
+				  /// Beginning of the tile
+				  const TensIdx beg=
+				    iTile*tileSize;
+				  
+				  /// End of the tile
+				  const TensIdx end=
+				    std::min(beg+tileSize,outerSize);
+				  
+				  /// Accumulation tensor restricted to the tile
+				  auto acc=
+				    accs[threadId].getOuterRangeView(0,end-beg);
+				  
+				  /// Contraction restricted to the tile
+				  const auto tile=
+				    rhs.restrictedToOuterRange(beg,end);
+				  
+				  for(TensIdx kBeg=0;kBeg<size;kBeg+=CONTRACTION_BLOCK_SIZE)
+				    {
+				      /// Contraction restricted to the tile and the block
+				      auto block=
+					tile.restrictedToBlock(kBeg,std::min(kBeg+CONTRACTION_BLOCK_SIZE,size));
+				      
+				      if(kBeg==0)
+					assignThroughAssigner(acc,std::move(block));
+				      else
+					assignThroughAssigner(acc,acc+std::move(block));
+				    }
+				  
+				  assignThroughAssigner(lhs.getOuterRangeView(beg,end),acc);
+				}
+			    });
+  }
+  
+  /// Assigns a contraction
+  ///
+  /// If the l.h.s aliases one of the factors, the contraction is
+  /// evaluated on a temporary tensor, which is then copied to the
+  /// l.h.s. A contraction along a dynamic component larger than a
+  /// block is split in blocks, accumulated on tiles of the result,
+  /// if the l.h.s allows it. Otherwise all the contracted components
+  /// are summed at once for each element of the l.h.s.
+  template <typename Lhs, 	    // Type of the l.h.s \c SmET
+	    typename Rhs, 	    // Type of the r.h.s \c Contracter
+	    SFINAE_ON_TEMPLATE_ARG(isSmET<Unqualified<Lhs>> and
+				   Unqualified<Lhs>::isAssignable and
+				   isContracter<Rhs>)>
+  void assign(Lhs&& lhs,             ///< Left hand side
+	      Rhs&& rhs)             ///< Right hand side, contraction to assign
+  {
+    if(rhs.isAliasing(getStor(lhs)))
+      {
+	/// Temporary result, not aliasing the factors
+	auto res=
+	  rhs.resultTens();
+	
+	assign(res,forw<Rhs>(rhs));
+	
+	assignThroughAssigner(forw<Lhs>(lhs),res);
+      }
+    else
+      if constexpr(RemRef<Rhs>::hasBlockedComp and canAssignContractionInTiles<Lhs,Rhs>())
+	{
+	  if(rhs.blockedCompSize()>CONTRACTION_BLOCK_SIZE)
+	    assignContractionInTiles(lhs,rhs);
+	  else
+	    assignThroughAssigner(forw<Lhs>(lhs),forw<Rhs>(rhs));
+	}
+      else
+	assignThroughAssigner(forw<Lhs>(lhs),forw<Rhs>(rhs));
+  }
+  
+  /// Assigns an expression containing a contraction
+  ///
+  /// If a contraction aliases the l.h.s, as in \c a=a*b+c or \c
+  /// a=-(a*b), the expression is evaluated on a temporary tensor,
+  /// which is then copied to the l.h.s.
+  template <typename Lhs, 	    // Type of the l.h.s \c SmET
+	    typename Rhs, 	    // Type of the r.h.s \c SmET
+	    SFINAE_ON_TEMPLATE_ARG(isSmET<Unqualified<Lhs>> and
+				   Unqualified<Lhs>::isAssignable and
+				   not isContracter<Rhs> and
+				   not isTransposer<Rhs> and
+				   containsContracter<Rhs>())>
+  void assign(Lhs&& lhs,             ///< Left hand side
+	      Rhs&& rhs)             ///< Right hand side, containing a contraction
+  {
+    if(isContractionAliasing(rhs,getStor(lhs)))
+      {
+	/// Temporary result, not aliasing the factors
+	auto res=
+	  tensWithSizesOf(rhs);
+	
+	assignThroughAssigner(res,forw<Rhs>(rhs));
+	
+	assignThroughAssigner(forw<Lhs>(lhs),res);
+      }
+    else
+      assignThroughAssigner(forw<Lhs>(lhs),forw<Rhs>(rhs));
+  }
+}
+
+#endif
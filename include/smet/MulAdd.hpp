@@ -5,8 +5,12 @@
 ///
 /// \brief Defines a class which take the sum of a \c SmET with the product of two others
 ///
-/// For the moment this is just used to provide a testcase to write the generic Nnary
+/// If both factors contain the \c Compl component, the product is
+/// the complex one. This is the core of the axpy and caxpy operations,
+/// so that a dedicated evaluation on SIMD packs is provided, using the
+/// fused multiply-add instructions.
 
+#include <physics/Compl.hpp>
 #include <smet/Reference.hpp>
 #include <smet/NnarySmET.hpp>
 #include <tens/TensKind.hpp>
@@ -34,6 +38,9 @@ namespace SUNphi
 	       ADDEND};
     
     /// Representative function of the multiply-sum operation
+    ///
+    /// When called with \c SmET, as when building the merged view, a
+    /// new \c MulAdder is returned
     template <typename Fact1,  // Type of the first factor
 	      typename Fact2,  // Type of the second factor
 	      typename Addend> // Type of the third factor
@@ -41,6 +48,9 @@ namespace SUNphi
 					   Fact2&& fact2,   ///< Second factor
 					   Addend&& addend) ///< Third factor
     {
+      if constexpr(isSmET<Fact1>)
+	return mulAdd(forw<Fact1>(fact1),forw<Fact2>(fact2),forw<Addend>(addend));
+      else
       return fact1*fact2+addend;
     }
     
@@ -59,13 +69,180 @@ namespace SUNphi
     
     PROVIDE_POS_OF_RES_TCS_IN_REFS;
     
-    NO_EXTRA_MERGE_DELIMS;
+    /// Check whether the product is the complex one
+    static constexpr bool isComplProduct=
+      isComplTensKind<TkOf<Ref<FACT1>>> and
+      isComplTensKind<TkOf<Ref<FACT2>>>;
+    
+    static_assert(not isComplProduct or isComplTensKind<Tk>,"The addend of a complex product must be complex");
+    
+    /// Position of the \c Compl component in the result, if present alone
+    static constexpr int posOfCompl=
+      posOfTypeNotAsserting<Compl,typename Tk::types>;
+    
+    /// Position of the component selecting real and imaginary part
+    ///
+    /// This is the innermost one if \c Compl has been merged into it
+    static constexpr int posOfReIm=
+      (posOfCompl!=NOT_PRESENT)?posOfCompl:(Tk::nTypes-1);
+    
+    // The Compl component of a complex product can be merged only if innermost, keeping real and imaginary part interleaved
+    PROVIDE_EXTRA_MERGE_DELIMS(Conditional<isComplProduct and posOfCompl!=NOT_PRESENT and posOfCompl!=Tk::nTypes-1,
+			       IntSeq<posOfCompl,posOfCompl+1>,
+			       IntSeq<>>);
     
     PROVIDE_MERGEABLE_COMPS_ACCORDING_TO_REFS_AND_EXTRA;
     
     PROVIDE_NNARY_GET_MERGED_COMPS_VIEW_ACCORDING_TO_REPRESENTATIVE_FUNCTION;
     
-    EVAL_THROUGH_REPRESENTATIVE_FUNCTION_PASSING_COMPS_BY_NAME;
+    /// Components pointing to the real and imaginary part of the passed ones
+    ///
+    /// The real part is the first element of the returned \c Tuple,
+    /// the imaginary one the second
+    template <typename...Args>    // Type of the arguments
+    static auto reImComps(const Args&...args)  ///< Components to get
+    {
+      /// Components pointing to the real part
+      Tuple<Args...> re(args...);
+    
+      /// Components pointing to the imaginary part
+      Tuple<Args...> im(args...);
+      
+      /// Real or imaginary part selected by the components
+      const auto ri=
+	get<posOfReIm>(re)%2;
+      
+      get<posOfReIm>(re)-=
+	ri;
+      
+      get<posOfReIm>(im)+=
+	1-ri;
+      
+      return
+	std::make_tuple(re,im);
+    }
+    
+    /// Evaluator for \c MulAdder
+    ///
+    /// The real and imaginary part of the factors are evaluated
+    /// separately for the complex product
+    template <typename...Args>    // Type of the arguments
+    DECLAUTO eval(const Args&...args)    ///< Components to get
+      const
+    {
+      STATIC_ASSERT_ARE_N_TYPES(Tk::nTypes,args);
+      
+      if constexpr(not isComplProduct)
+	return
+	  this->evalThroughRepresentativeFunctionPassingCompsByName(IntsUpTo<NSmET>{},args...);
+      else
+	{
+	  /// Components of the real and imaginary parts
+	  const auto [re,im]=
+	    reImComps(args...);
+	  
+	  /// Real part of the first factor
+	  const auto fact1Re=
+	    this->template refEvalByCompsName<FACT1>(re);
+	  
+	  /// Imaginary part of the first factor
+	  const auto fact1Im=
+	    this->template refEvalByCompsName<FACT1>(im);
+	  
+	  /// Real part of the second factor
+	  const auto fact2Re=
+	    this->template refEvalByCompsName<FACT2>(re);
+	  
+	  /// Imaginary part of the second factor
+	  const auto fact2Im=
+	    this->template refEvalByCompsName<FACT2>(im);
+	  
+	  /// Addend
+	  const auto addend=
+	    this->template refEvalByCompsName<ADDEND>(std::forward_as_tuple(args...));
+	  
+	  if(get<posOfReIm>(std::forward_as_tuple(args...))%2)
+	    return
+	      fact1Re*fact2Im+fact1Im*fact2Re+addend;
+	  else
+	    return
+	      fact1Re*fact2Re-fact1Im*fact2Im+addend;
+	}
+    }
+    
+    PROVIDE_ALSO_NON_CONST_METHOD(eval);
+    
+    CAN_EVAL_SIMD_ATTRIBUTE(/*! Vectorizable if all refs are */,
+			    ((SUNphi::canEvalSIMD<RemRef<_Refs>> and
+			      isSame<Unqualified<typename RemRef<_Refs>::Fund>,Unqualified<Fund>>) && ...));
+    
+    /// SIMD evaluator for \c MulAdder, using fused multiply-add
+    ///
+    /// If the vectorized component has \c Compl innermost, each pack
+    /// contains interleaved complex numbers, multiplied with \c
+    /// complFma. This requires the pack to begin on a real part, as
+    /// it is the case when looping on packs from the beginning of the
+    /// component. Otherwise, in the complex case, real and imaginary
+    /// parts are evaluated on separate packs.
+    template <typename VC,          // Component to vectorize
+	      SIMDBackend B,        // SIMD backend
+	      typename...Args>      // Type of the arguments
+    auto evalSIMD(const Args&...args)    ///< Components of the first element
+      const
+    {
+      STATIC_ASSERT_ARE_N_TYPES(Tk::nTypes,args);
+      
+      /// Addend
+      const auto addend=
+	this->template refEvalSIMDByCompsName<VC,B,ADDEND>(std::forward_as_tuple(args...));
+      
+      if constexpr(not isComplProduct or endsWithCompl<VC>)
+	{
+	  /// First factor
+	  const auto fact1=
+	    this->template refEvalSIMDByCompsName<VC,B,FACT1>(std::forward_as_tuple(args...));
+	  
+	  /// Second factor
+	  const auto fact2=
+	    this->template refEvalSIMDByCompsName<VC,B,FACT2>(std::forward_as_tuple(args...));
+	  
+	  if constexpr(isComplProduct)
+	    return
+	      complFma(fact1,fact2,addend);
+	  else
+	    return
+	      fma(fact1,fact2,addend);
+	}
+      else
+	{
+	  /// Components of the real and imaginary parts
+	  const auto [re,im]=
+	    reImComps(args...);
+	  
+	  /// Real part of the first factor
+	  const auto fact1Re=
+	    this->template refEvalSIMDByCompsName<VC,B,FACT1>(re);
+	  
+	  /// Imaginary part of the first factor
+	  const auto fact1Im=
+	    this->template refEvalSIMDByCompsName<VC,B,FACT1>(im);
+	  
+	  /// Real part of the second factor
+	  const auto fact2Re=
+	    this->template refEvalSIMDByCompsName<VC,B,FACT2>(re);
+	  
+	  /// Imaginary part of the second factor
+	  const auto fact2Im=
+	    this->template refEvalSIMDByCompsName<VC,B,FACT2>(im);
+	  
+	  if(get<posOfReIm>(std::forward_as_tuple(args...))%2)
+	    return
+	      fma(fact1Re,fact2Im,fma(fact1Im,fact2Re,addend));
+	  else
+	    return
+	      fma(fact1Re,fact2Re,fma(-fact1Im,fact2Im,addend));
+	}
+    }
     
     PROVIDE_NNARY_SMET_SIMPLE_CREATOR(MulAdder);
 };
@@ -9,6 +9,7 @@
 #include <smet/BaseSmET.hpp>
 #include <smet/Reference.hpp>
 #include <tens/TensKind.hpp>
+#include <tuple/TupleElements.hpp>
 #include <tuple/TupleOrder.hpp>
 #include <utility/Position.hpp>
 
@@ -99,6 +100,54 @@ namespace SUNphi
     }
     
     PROVIDE_ALSO_NON_CONST_METHOD(evalThroughRepresentativeFunctionPassingCompsByName);
+    
+    /// Evaluate the I-th reference on a SIMD pack along VC, getting from the \c Tuple targs the element \c Pos
+    ///
+    /// Internal implementation
+    template <typename VC,   // Component to vectorize
+	      SIMDBackend B, // SIMD backend
+	      int I,         // Reference to evaluate
+	      typename Tp,   // Type of the \c Tuple containing the components to call
+	      int...Pos>     // Position of the args
+    DECLAUTO _refEvalSIMDByCompsName(IntSeq<I>,
+				     IntSeq<Pos...>,    ///< List of position of components for ref
+				     Tp&& targs) const  ///< Components to get
+    {
+      return get<I>((~*this).refs).template evalSIMD<VC,B>(get<Pos>(targs)...);
+    }
+    
+    /// Evaluate the I-th reference on a SIMD pack along VC, getting from the \c Tuple targs the element \c Pos
+    ///
+    /// External implementation, using \c PosOfResTcsPresInRefsTk to dispatch components
+    template <typename VC,   // Component to vectorize
+	      SIMDBackend B, // SIMD backend
+	      int I,         // Reference to evaluate
+	      typename Tp>   // Type of the \c Tuple containing the components to call
+    DECLAUTO refEvalSIMDByCompsName(Tp&& targs) const  ///< Components to get
+    {
+      /// Position of \c TensComp of the reference Tk present in thr result
+      using Pos=
+	TupleElementType<I,typename T::PosOfResTcsPresInRefsTk>;
+      
+      return _refEvalSIMDByCompsName<VC,B>(IntSeq<I>{},Pos{},forw<Tp>(targs));
+    }
+    
+    /// Evaluate the result on a SIMD pack along VC by calling a representative function
+    ///
+    /// The representative function is called with the packs obtained
+    /// from each reference, so it must be expressed through operations
+    /// supported by \c SIMDPack
+    template <typename VC,        // Component to vectorize
+	      SIMDBackend B,          // SIMD backend
+	      int...I,
+	      typename...Args>    // Type of the arguments
+    DECLAUTO evalSIMDThroughRepresentativeFunctionPassingCompsByName(IntSeq<I...>,               ///< Dummy \c IntSeq to infer I
+								     const Args&...args) const   ///< Components of the first element
+    {
+      STATIC_ASSERT_ARE_N_TYPES(T::Tk::nTypes,args);
+      
+      return (~*this).representativeFunction(this->template refEvalSIMDByCompsName<VC,B,I>(std::forward_as_tuple(args...))...);
+    }
   };
   
   /// Provides an evaluator through a representative function
@@ -119,6 +168,28 @@ namespace SUNphi
 									\
   PROVIDE_ALSO_NON_CONST_METHOD(eval)
   
+  /// Provides a SIMD evaluator through a representative function
+  ///
+  /// The \c SmET can be evaluated on a SIMD pack if all references can,
+  /// and have the same \c Fund of the result
+#define EVAL_SIMD_THROUGH_REPRESENTATIVE_FUNCTION_PASSING_COMPS_BY_NAME	\
+  CAN_EVAL_SIMD_ATTRIBUTE(/*! Vectorizable if all refs are */,		\
+			  ((SUNphi::canEvalSIMD<RemRef<_Refs>> and	\
+			    isSame<Unqualified<typename RemRef<_Refs>::Fund>,Unqualified<Fund>>) && ...)); \
+									\
+  /*! SIMD evaluator, external interface                         */	\
+  /*!                                                            */	\
+  /*! Evaluate the \c representativeFunction on the SIMD pack of  */	\
+  /*! each reference along the component VC                      */	\
+  template <typename VC,              /* Component to vectorize  */	\
+	    SIMDBackend B,            /* SIMD backend            */	\
+	    typename...Args>          /* Type of the arguments   */	\
+  DECLAUTO evalSIMD(const Args&...args) const /* Components to get */	\
+  {									\
+    return this->template evalSIMDThroughRepresentativeFunctionPassingCompsByName<VC,B>(IntsUpTo<NSmET>{}, \
+										   args...); \
+  }
+  
   /// Provide the references to the objects
   ///
   /// The reference types are contained in a \c Tuple with types
@@ -152,7 +223,7 @@ namespace SUNphi
   /*! Returns the size in the first found ref */			\
   template <typename TC, /* \c TensComp to search           */		\
 	    int I=0>     /* Integer of the ref to search in */		\
-  int compSize() const							\
+  TensIdx compSize() const						\
   {									\
     static_assert(I>=0 and I<NSmET,"Cannot search in negative or larger-than-N ref"); \
 									\
@@ -162,7 +233,7 @@ namespace SUNphi
 									\
     /*! Check if the \c TensKind contains the \c TensComp asked */	\
     constexpr bool found=						\
-      RefTk::template contains<TC>;					\
+      tupleHasType<TC,typename RefTk::types>;				\
 									\
     /* Returns the size if it's in the I-th Tk */			\
     if constexpr(found)							\
@@ -347,12 +418,13 @@ namespace SUNphi
     using MDs=								\
       Tuple<InsertInOrderedIntSeq /* Insert the begin */		\
 	    <0,        /* Insert 0 as begin */				\
-	     IntSeqGetElsAfterAppending					\
+	     SortedUniqueIntSeq /* Sort, the ref can be permuted */	\
+	     <IntSeqGetElsAfterAppending				\
 	     <RemRef<_Refs>::Tk::nTypes,				\
 	      false,   /* Omit NOT_PRESENT */				\
 	      Is,							\
 	      PosOfTypesNotAsserting<typename Tk::types,		\
-				     typename RemRef<_Refs>::Tk::types>>, \
+				      typename RemRef<_Refs>::Tk::types>>>, \
 	     0,         /* Shift after inserting */			\
 	     true>...>; /* Ignore 0 if present   */			\
     									\
@@ -416,16 +488,25 @@ namespace SUNphi
   SWALLOW_SEMICOLON_AT_GLOBAL_SCOPE
   
   /// Set aliasing according to the isAliasing of references
-  /// \todo enforce cehck only with TensClass
+  ///
+  /// The \c SmET is aliasing if any of the references is
 #define FORWARD_IS_ALIASING_TO_REFS			\
   /*! Forward aliasing check to the references */	\
   template <typename Tref>				\
   bool isAliasing(const Tref& alias) const		\
   {							\
-    CRASH<<"Fixme";					\
+    /* Result */					\
+    bool res=						\
+      false;						\
+							\
+    forEach(refs,[&res,&alias](const auto& ref)		\
+		 {					\
+		   res|=				\
+		     ref.isAliasing(alias);		\
+		 });					\
 							\
     return						\
-      true;						\
+      res;						\
   }
   
   /// Provides \c Fund, \c eval and \c mergedComps according to \c representativeFunction
@@ -438,7 +519,9 @@ namespace SUNphi
 									\
   PROVIDE_NNARY_GET_MERGED_COMPS_VIEW_ACCORDING_TO_REPRESENTATIVE_FUNCTION; \
   									\
-  EVAL_THROUGH_REPRESENTATIVE_FUNCTION_PASSING_COMPS_BY_NAME
+  EVAL_THROUGH_REPRESENTATIVE_FUNCTION_PASSING_COMPS_BY_NAME;		\
+  									\
+  EVAL_SIMD_THROUGH_REPRESENTATIVE_FUNCTION_PASSING_COMPS_BY_NAME
   
   
   /// Implements a duplicated-call canceller
@@ -8,6 +8,7 @@
 ///
 
 #include <smet/NnarySmET.hpp>
+#include <system/SIMD.hpp>
 #include <tens/TensKind.hpp>
 
 namespace SUNphi
@@ -30,7 +31,7 @@ namespace SUNphi
     IDENTITY_REPRESENTATIVE_FUNCTION;
     
     /// Returns the size of a component, which is always 1
-    int compSize() const
+    TensIdx compSize() const
     {
       return 1;
     }
@@ -56,8 +57,8 @@ namespace SUNphi
     STORING;
     IS_ASSIGNABLE_ATTRIBUTE(/*! The SmET is assignable if ref is */,
 			    isLvalue<_Fund> and (not isConst<_Fund>));
-    PROVIDE_IS_ALIASING(/*! Check with storage */,
-			return alias==scRef;);
+    PROVIDE_IS_ALIASING(/*! Check whether the scalar lies in the storage */,
+			return alias.overlapsWith(&scRef,&scRef+1););
     
     /// Returns a component-merged version
     PROVIDE_GET_MERGED_COMPS_VIEW(/*! Returns the ScalarWrap itself */,
@@ -78,7 +79,6 @@ namespace SUNphi
     auto& eval(Args&&...args)
       const
     {
-      std::cout<<" is: "<<isLvalue<_Fund><<", "<<isLvalue<decltype(scRef)><<" "<<scRef<<std::endl;
       STATIC_ASSERT_ARE_N_TYPES(0,args);
       
       return scRef;
@@ -86,6 +86,21 @@ namespace SUNphi
     
     PROVIDE_ALSO_NON_CONST_METHOD(eval);
     
+    CAN_EVAL_SIMD_ATTRIBUTE(/*! The scalar is broadcast */,true);
+    
+    /// Returns a pack filled with the scalar
+    template <typename VC,     // Component to vectorize, irrelevant
+	      SIMDBackend B,   // SIMD backend
+	      typename...Args> // Arguments (need to be empty)
+    SIMDPack<Unqualified<Fund>,B> evalSIMD(const Args&...args)
+      const
+    {
+      STATIC_ASSERT_ARE_N_TYPES(0,args);
+      
+      return
+	SIMDPack<Unqualified<Fund>,B>::broadcast(scRef);
+    }
+    
     /// Constructor taking universal reference
     template <typename T,
 	      typename=EnableIf<isSame<Unqualified<T>,Unqualified<_Fund>>>>
@@ -26,13 +26,25 @@ namespace SUNphi
     
     PROVIDE_NNARY_SMET_REFS_AND_CHECK_ARE_N(1);
     
-    IDENTITY_REPRESENTATIVE_FUNCTION;
+    /// Returns the argument, transposed if it is a \c SmET
+    ///
+    /// The values are evaluated with the components already swapped,
+    /// so they are returned as they are, while the merged view of the
+    /// reference needs to be transposed again
+    template <typename T>                          // Argument type
+    static DECLAUTO representativeFunction(T&& t)  ///< Argument
+    {
+      if constexpr(isSmET<T>)
+	return transpose(forw<T>(t));
+      else
+	return forw<T>(t);
+    }
     
     /// Returns the size of a component
     ///
     /// The result is the size of the twinned component
     template <typename TC>
-    int compSize() const
+    TensIdx compSize() const
     {
       return get<0>(refs).template compSize<TwinCompOf<TC>>();
     }
@@ -29,7 +29,7 @@ namespace SUNphi
     template <typename T>                         // Type of the argument to negate
     static DECLAUTO representativeFunction(T&& t) ///< Argument to negate
     {
-      return -t;
+      return -forw<T>(t);
     }
     
     PROVIDE_SIMPLE_NNARY_COMP_SIZE;
@@ -69,7 +69,7 @@ namespace SUNphi
   /*! Returns the size of a component, matching the reference */	\
   template <typename TC,						\
   	    SFINAE_WORSEN_DEFAULT_VERSION_TEMPLATE_PARS>		\
-  int compSize(SFINAE_WORSEN_DEFAULT_VERSION_ARGS) const		\
+  TensIdx compSize(SFINAE_WORSEN_DEFAULT_VERSION_ARGS) const	\
   {									\
     SFINAE_WORSEN_DEFAULT_VERSION_ARGS_CHECK;				\
     									\
@@ -82,7 +82,7 @@ namespace SUNphi
   /*! Returns the size of component TC */				\
   template <typename T,							\
 	    SFINAE_ON_TEMPLATE_ARG(isSame<T,TC>)>			\
-  int compSize() const							\
+  TensIdx compSize() const						\
   {									\
     __VA_ARGS__;							\
   }
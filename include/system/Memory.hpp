@@ -4,13 +4,67 @@
 /// \file Memory.hpp
 ///
 /// \brief Header file for the allocation and deallocation of memory
-/// \todo: implement memory pool and cacher
+///
+/// Memory is handed out in blocks of a discrete set of sizes, the
+/// size classes: each power of two is divided into four classes, so
+/// that at most one fourth of a block is wasted. Each block is
+/// preceded by a header, recording the pointer returned by the
+/// system, the size class and the thread cache owning the block.
+///
+/// Released blocks are kept in the cache of the owner thread, one
+/// free list per size class, and reused best-fit: a request is served
+/// by the smallest cached block of the same or of a slightly larger
+/// class. A thread releasing a block owned by another thread pushes it
+/// onto a lock-free stack of the owner, which is drained by the owner
+/// itself when it misses a block. Allocation and release are thus
+/// thread-safe and lock-free, the only lock being taken the first time
+/// a thread allocates, to get its cache.
+///
+/// The size of the blocks cached by each thread can be capped: when
+/// the cap is exceeded, the owner of the cache evicts the blocks of the
+/// least recently used size classes, giving them back to the system.
+/// Blocks released by other threads are accounted to the owner, which
+/// evicts them at its next release or allocation. The physical pages of the cached blocks can
+/// also be given back while keeping the blocks, through
+/// \c adviseUnneededCachedPages.
+///
+/// Each allocation can carry a tag, such as the name of the kind of
+/// tensor being stored, and the memory used is accounted per tag and
+/// per thread cache, so that the owners of the memory can be reported
+/// at any time through \c printUsageReport.
+///
+/// Blocks larger than a threshold have their data aligned to the huge
+/// page size and advised to be backed by transparent huge pages, or
+/// optionally mapped explicitly from the hugetlbfs pool, to reduce TLB
+/// misses.
+
+#ifdef HAVE_CONFIG_H
+ #include "config.hpp"
+#endif
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
 #include <cstdlib>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
 
+#ifdef HAVE_LINUX_MEMPOLICY_H
+ #include <linux/mempolicy.h>
+ #include <sys/syscall.h>
+#endif
+
+#include <containers/Vector.hpp>
 #include <debug/Crash.hpp>
 #include <ios/Logger.hpp>
 #include <system/SIMD.hpp>
+#include <threads/Mutex.hpp>
+#include <threads/Pool.hpp>
+#include <threads/Thread.hpp>
 #include <utility/ValWithExtreme.hpp>
 
 namespace SUNphi
@@ -22,179 +76,817 @@ namespace SUNphi
   /// Memory manager
   class Memory
   {
-    /// List of dynamical allocated memory
-    std::map<void*,size_t> used;
+  public:
+    
+    /// Tag carried by allocations, accounting the memory they use
+    struct Tag
+    {
+      /// Name of the tag
+      const std::string name;
+      
+      /// Size of memory used
+      AtomicValWithMax<size_t> usedSize;
+      
+      /// Number of allocations performed
+      std::atomic<size_t> nAlloc{0};
+      
+      /// Creates the tag with the given name
+      Tag(const std::string& name) ///< Name of the tag
+	: name(name)
+      {
+      }
+    };
+    
+    /// Usage of memory by a tag or a thread
+    struct Usage
+    {
+      /// Name of the user
+      std::string name;
+      
+      /// Size currently used
+      size_t size;
+      
+      /// Maximal size used
+      size_t maxSize;
+      
+      /// Number of allocations performed
+      size_t nAlloc;
+    };
+    
+  private:
+    
+    /// Logarithm of the size of the smallest size class
+    static constexpr int LOG2_MIN_CLASS_SIZE=
+      6;
+    
+    /// Number of classes in which each power of two is divided
+    static constexpr int N_CLASSES_PER_POW2=
+      4;
+    
+    /// Number of size classes
+    static constexpr int N_SIZE_CLASSES=
+      1+N_CLASSES_PER_POW2*(64-LOG2_MIN_CLASS_SIZE);
+    
+    /// Number of larger classes searched when looking for a cached block
+    ///
+    /// Spanning a whole power of two, at most half of a reused block
+    /// is wasted
+    static constexpr int N_BEST_FIT_CLASSES=
+      N_CLASSES_PER_POW2;
+    
+    struct ThreadCache;
+    
+    /// Size of the huge pages
+    static constexpr size_t HUGE_PAGE_SIZE=
+      size_t{1}<<21;
+    
+    /// Default size above which huge pages are used
+    static constexpr size_t DEFAULT_HUGE_PAGES_THRESHOLD=
+      2*HUGE_PAGE_SIZE;
+    
+    /// Way in which a block has been obtained from the system
+    enum class RawAllocation{MEMALIGN,           ///< Through posix_memalign
+			     HUGE_PAGES,         ///< Through posix_memalign aligned to the huge page, advised to use transparent huge pages
+			     HUGETLBFS};         ///< Mapped explicitly from the hugetlbfs pool
     
-    /// List of cached allocated memory
-    std::map<size_t,std::vector<void*>> cached;
+    /// Header preceding each block
+    struct BlockHeader
+    {
+      /// Pointer returned by the system
+      void* raw;
+      
+      /// Size allocated from the system
+      size_t rawSize;
+      
+      /// Way in which the block has been allocated
+      RawAllocation rawAllocation;
+      
+      /// Next block in the free list or in the stack of remote frees
+      BlockHeader* next;
+      
+      /// Cache of the thread owning the block
+      ThreadCache* owner;
+      
+      /// Size class of the block
+      int sizeClass;
+      
+      /// Tag of the allocation
+      Tag* tag;
+      
+      /// Mark whether the pages of the cached block have been given back to the system
+      bool advisedUnneeded;
+    };
+    
+    /// Cache of the blocks released by a thread
+    ///
+    /// Only the thread using the cache accesses the free lists, while
+    /// the other threads can only push onto the stack of remote frees
+    struct alignas(CACHE_LINE_SIZE) ThreadCache
+    {
+      /// Memory manager to which the cache belongs
+      Memory* memory;
+      
+      /// Token of the thread using the cache, expired when the thread ends
+      std::weak_ptr<bool> user;
+      
+      /// Free blocks of each size class
+      BlockHeader* freeLists[N_SIZE_CLASSES]{};
+      
+      /// Counter of the accesses to the free lists, used to order them by last use
+      uint64_t clock{0};
+      
+      /// Value of the clock at the last access to each free list
+      uint64_t lastUse[N_SIZE_CLASSES]{};
+      
+      /// Blocks released by other threads
+      alignas(CACHE_LINE_SIZE) std::atomic<BlockHeader*> remoteFrees{nullptr};
+      
+      /// Size of the blocks in the free lists and in the stack of remote frees
+      std::atomic<size_t> cachedSize{0};
+      
+      /// Size of memory used by blocks allocated by the thread, also released by other threads
+      AtomicValWithMax<size_t> usedSize;
+      
+      /// Number of allocations performed by the thread
+      std::atomic<size_t> nAlloc{0};
+      
+      /// Creates the cache for a given memory manager
+      ThreadCache(Memory* memory) ///< Memory manager
+	: memory(memory)
+      {
+      }
+    };
+    
+    /// Holds the cache of the current thread
+    ///
+    /// When the thread ends, the token is destroyed and the cache can be
+    /// adopted by another thread. The cache itself is not accessed, so
+    /// that threads can end after the memory manager
+    struct ThreadCacheHandle
+    {
+      /// Cache of the thread
+      ThreadCache* cache;
+      
+      /// Token marking that the thread is alive
+      std::shared_ptr<bool> token;
+      
+      /// Creates the handle, with no cache
+      ThreadCacheHandle() :
+	cache(nullptr)
+      {
+      }
+    };
+    
+    /// Handle to the cache of the current thread
+    static inline thread_local ThreadCacheHandle threadCacheHandle;
+    
+    /// Caches of all threads
+    ///
+    /// Caches are never destroyed before the memory manager, as blocks
+    /// can still refer to them, but can be adopted by a new thread
+    std::deque<ThreadCache> threadCaches;
+    
+    /// Mutex protecting the list of caches
+    Mutex threadCachesMutex;
+    
+    /// Tags of the allocations, the first being used for untagged ones
+    ///
+    /// Tags are never destroyed before the memory manager, so that
+    /// they can be referred to by pointer
+    std::deque<Tag> tags;
+    
+    /// Mutex protecting the list of tags
+    Mutex tagsMutex;
     
     /// Size of used memory
-    ValWithMax<size_t> usedSize;
+    AtomicValWithMax<size_t> usedSize;
     
     /// Size of cached memory
-    ValWithMax<size_t> cachedSize;
+    AtomicValWithMax<size_t> cachedSize;
     
     /// Use or not cache
     bool useCache{true};
     
+    /// Maximal size of cached memory of each thread, beyond which blocks are evicted
+    size_t maxCachedSize{std::numeric_limits<size_t>::max()};
+    
+    /// Number of blocks evicted from the cache
+    std::atomic<size_t> nEvicted{0};
+    
+    /// Size of the blocks evicted from the cache
+    std::atomic<size_t> evictedSize{0};
+    
+    /// Size of cached memory whose pages have been given back to the system
+    std::atomic<size_t> advisedUnneededSize{0};
+    
     /// Number of unaligned allocation performed
-    size_t nUnalignedAlloc{0};
+    std::atomic<size_t> nUnalignedAlloc{0};
     
     /// Number of aligned allocation performed
-    size_t nAlignedAlloc{0};
+    std::atomic<size_t> nAlignedAlloc{0};
     
     /// Number of cached memory reused
-    size_t nCachedReused{0};
+    std::atomic<size_t> nCachedReused{0};
     
-    /// Get aligned memory
-    ///
-    /// Call the system routine which allocate memory
-    void* allocateRawAligned(const size_t size,         ///< Amount of memory to allocate
-			     const size_t alignment)    ///< Required alignment
+    /// Number of failed binding to NUMA nodes
+    std::atomic<size_t> nFailedNumaBind{0};
+    
+    /// Touch for the first time in parallel the allocated memory
+    bool useParallelFirstTouch{true};
+    
+    /// Size above which huge pages are used
+    size_t hugePagesThreshold{DEFAULT_HUGE_PAGES_THRESHOLD};
+    
+    /// Use or not explicit hugetlbfs mapping for large blocks
+    bool useHugetlbfs{false};
+    
+    /// Number of allocations advised to use transparent huge pages
+    std::atomic<size_t> nHugePagesAlloc{0};
+    
+    /// Size allocated advising to use transparent huge pages
+    AtomicValWithMax<size_t> hugePagesSize;
+    
+    /// Number of allocations mapped from hugetlbfs
+    std::atomic<size_t> nHugetlbfsAlloc{0};
+    
+    /// Size mapped from hugetlbfs
+    AtomicValWithMax<size_t> hugetlbfsSize;
+    
+    /// Number of failed mapping from hugetlbfs, replaced by transparent huge pages
+    std::atomic<size_t> nFailedHugetlbfsAlloc{0};
+    
+    /// Size class needed to hold a given size
+    static int sizeClassOf(const size_t size) ///< Size to hold
     {
-      // runLog()<<"Raw allocating "<<size;
+      if(size<=(size_t{1}<<LOG2_MIN_CLASS_SIZE))
+	return
+	  0;
       
-      /// Result
-      void* ptr=
-	nullptr;
+      /// Logarithm of the power of two immediately smaller than size
+      const int log2=
+	63-__builtin_clzll(size-1);
       
-      /// Returned condition
-      int rc=
-	posix_memalign(&ptr,
-		       alignment,
-		       size);
+      /// Class inside the power of two
+      const int subClass=
+	((size-1)>>(log2-2))%N_CLASSES_PER_POW2;
       
-      if(rc)
-	CRASH<<"Failed to allocate "<<size<<" with alignement "<<ALIGNMENT;
+      return
+	1+(log2-LOG2_MIN_CLASS_SIZE)*N_CLASSES_PER_POW2+subClass;
+    }
+    
+    /// Size of the blocks of a given size class
+    static size_t classSize(const int sizeClass) ///< Size class
+    {
+      if(sizeClass==0)
+	return
+	  size_t{1}<<LOG2_MIN_CLASS_SIZE;
+      
+      /// Logarithm of the power of two immediately smaller than the size
+      const int log2=
+	LOG2_MIN_CLASS_SIZE+(sizeClass-1)/N_CLASSES_PER_POW2;
       
-      nAlignedAlloc++;
+      /// Class inside the power of two
+      const int subClass=
+	(sizeClass-1)%N_CLASSES_PER_POW2;
       
       return
-	ptr;
+	(size_t{1}<<log2)+(subClass+1)*(size_t{1}<<(log2-2));
     }
     
-    /// Add to the list of used memory
-    void pushToUsed(void* ptr,
-		    const size_t size)
+    /// Header of a block
+    static BlockHeader* headerOf(void* ptr) ///< Pointer handed out
     {
-      used[ptr]=
-	size;
+      return
+	static_cast<BlockHeader*>(ptr)-1;
+    }
+    
+    /// Pointer handed out for a block
+    static void* ptrOf(BlockHeader* header) ///< Header of the block
+    {
+      return
+	header+1;
+    }
+    
+    /// Check if a pointer is suitably aligned
+    static bool isAligned(const void* ptr,
+			  const size_t alignment)
+    {
+      return
+	reinterpret_cast<uintptr_t>(ptr)%alignment==0;
+    }
+    
+    /// Gets a cache not used by any living thread, or creates a new one
+    ThreadCache* adoptThreadCache(const std::shared_ptr<bool>& token) ///< Token of the current thread
+    {
+      ScopeMutexLocker locker(threadCachesMutex);
       
-      usedSize+=
-	size;
+      for(ThreadCache& cache : threadCaches)
+	if(cache.user.expired())
+	  {
+	    cache.user=
+	      token;
+	    
+	    return
+	      &cache;
+	  }
+      
+      /// Created cache
+      ThreadCache& cache=
+	threadCaches.emplace_back(this);
+      
+      cache.user=
+	token;
+      
+      return
+	&cache;
+    }
+    
+    /// Gets the cache of the current thread
+    ThreadCache& getThreadCache()
+    {
+      /// Cache of the thread
+      ThreadCache*& cache=
+	threadCacheHandle.cache;
       
-      // runLog()<<"Pushing to used "<<ptr<<" "<<size<<", number of used:"<<used.size();
+      if(cache==nullptr or cache->memory!=this)
+	{
+	  // A new token releases the cache used so far, if any
+	  threadCacheHandle.token=
+	    std::make_shared<bool>(true);
+	  
+	  cache=
+	    adoptThreadCache(threadCacheHandle.token);
+	}
+      
+      return
+	*cache;
     }
     
-    /// Removes a pointer from the used list, without actually freeing associated memory
+    /// Get aligned memory
     ///
-    /// Returns the size of the memory pointed
-    size_t popFromUsed(void* ptr) ///< Pointer to the memory to move to cache
+    /// Call the system routine which allocate memory, leaving room
+    /// for the header before the returned pointer. Blocks larger than
+    /// the huge pages threshold start at a huge page boundary: the
+    /// header lies in the last regular page before the data, and only
+    /// the data is backed by huge pages.
+    BlockHeader* allocateRawAligned(const int sizeClass,        ///< Size class of the block
+				    const size_t alignment,     ///< Required alignment
+				    ThreadCache& owner)         ///< Owner of the block
     {
-      // runLog()<<"Popping from used "<<ptr;
+      /// Size of the block
+      const size_t size=
+	classSize(sizeClass);
       
-      /// Iterator to search result
-      auto el=
-	used.find(ptr);
+      // runLog()<<"Raw allocating "<<size;
       
-      if(el==used.end())
-	CRASH<<"Unable to find dinamically allocated memory "<<ptr;
+      /// Way in which the block is allocated
+      RawAllocation rawAllocation=
+	(size>=hugePagesThreshold)?RawAllocation::HUGE_PAGES:RawAllocation::MEMALIGN;
       
-      /// Size of memory
-      const size_t size=
-	el->second;
+      /// Alignment of the data
+      const size_t dataAlignment=
+	(rawAllocation==RawAllocation::HUGE_PAGES)?std::max(alignment,HUGE_PAGE_SIZE):alignment;
       
-      usedSize-=
-	size;
+      /// Room for the header, keeping the alignment of the data
+      const size_t headerRoom=
+	(sizeof(BlockHeader)+dataAlignment-1)/dataAlignment*dataAlignment;
       
-      used.erase(el);
+      /// Size to be allocated from the system
+      size_t rawSize=
+	headerRoom+size;
+      
+      /// Result
+      void* raw=
+	nullptr;
+      
+      /// Beginning of the data
+      char* data=
+	nullptr;
+
+#ifdef MAP_HUGETLB
+      
+      if(rawAllocation==RawAllocation::HUGE_PAGES and useHugetlbfs)
+	{
+	  /// Size rounded to the huge page
+	  const size_t mappedSize=
+	    (size+HUGE_PAGE_SIZE-1)/HUGE_PAGE_SIZE*HUGE_PAGE_SIZE;
+	  
+	  /// Size of the region reserved with regular pages, leaving room for the header and the alignment
+	  const size_t reservedSize=
+	    2*HUGE_PAGE_SIZE+mappedSize;
+	  
+	  /// Region reserved to host the header and the mapped data
+	  void* reserved=
+	    mmap(nullptr,reservedSize,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE,-1,0);
+	  
+	  if(reserved==MAP_FAILED)
+	    CRASH<<"Failed to reserve "<<reservedSize<<" bytes";
+	  
+	  /// First huge page boundary leaving room for the header
+	  char* mappedBeg=
+	    reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(reserved)+getPageSize()+HUGE_PAGE_SIZE-1)/HUGE_PAGE_SIZE*HUGE_PAGE_SIZE);
+	  
+	  // The pool of huge pages could be exhausted, in which case transparent huge pages are used
+	  if(mmap(mappedBeg,mappedSize,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB|MAP_FIXED,-1,0)==MAP_FAILED)
+	    {
+	      nFailedHugetlbfsAlloc++;
+	      
+	      munmap(reserved,reservedSize);
+	    }
+	  else
+	    {
+	      raw=
+		reserved;
+	      
+	      rawSize=
+		reservedSize;
+	      
+	      data=
+		mappedBeg;
+	      
+	      rawAllocation=
+		RawAllocation::HUGETLBFS;
+	      
+	      nHugetlbfsAlloc++;
+	      
+	      hugetlbfsSize+=
+		rawSize;
+	    }
+	}
+
+#endif
+      
+      if(raw==nullptr)
+	{
+	  /// Returned condition
+	  int rc=
+	    posix_memalign(&raw,
+			   dataAlignment,
+			   rawSize);
+	  
+	  if(rc)
+	    CRASH<<"Failed to allocate "<<size<<" with alignement "<<dataAlignment;
+	  
+	  data=
+	    static_cast<char*>(raw)+headerRoom;
+	  
+	  nAlignedAlloc++;
+	}
+      
+      if(rawAllocation==RawAllocation::HUGE_PAGES)
+	{
+#ifdef MADV_HUGEPAGE
+	  
+	  // Advise must be given before touching the memory
+	  madvise(data,size,MADV_HUGEPAGE);
+
+#endif
+	  
+	  nHugePagesAlloc++;
+	  
+	  hugePagesSize+=
+	    rawSize;
+	}
+      
+      /// Header of the block
+      BlockHeader* header=
+	headerOf(data);
+      
+      header->raw=
+	raw;
+      
+      header->rawSize=
+	rawSize;
+      
+      header->rawAllocation=
+	rawAllocation;
+      
+      header->owner=
+	&owner;
+      
+      header->sizeClass=
+	sizeClass;
+      
+      header->advisedUnneeded=
+	false;
       
       return
-	size;
+	header;
     }
     
-    /// Adds a memory to cache
-    void pushToCache(void* ptr,          ///< Memory to cache
-		     const size_t size)  ///< Memory size
+    /// Gives back a block to the system
+    void freeRaw(BlockHeader* header) ///< Block to free
     {
-      cached[size].push_back(ptr);
-      
-      cachedSize+=
-	size;
+      switch(header->rawAllocation)
+	{
+	case RawAllocation::HUGETLBFS:
+	  hugetlbfsSize-=
+	    header->rawSize;
+	  
+	  if(munmap(header->raw,header->rawSize))
+	    CRASH<<"Failed to unmap "<<header->rawSize<<" bytes of hugetlbfs";
+	  break;
+	case RawAllocation::HUGE_PAGES:
+	  hugePagesSize-=
+	    header->rawSize;
+	  
+	  free(header->raw);
+	  break;
+	case RawAllocation::MEMALIGN:
+	  free(header->raw);
+	  break;
+	}
+    }
+    
+    /// Moves the blocks released by other threads to the free lists
+    void drainRemoteFrees(ThreadCache& cache) ///< Cache to drain
+    {
+      /// Stack of blocks, taken all at once
+      BlockHeader* header=
+	cache.remoteFrees.exchange(nullptr,std::memory_order_acquire);
       
-      // runLog()<<"Pushing to cache "<<size<<" "<<ptr<<", cache size: "<<cached.size();
+      while(header)
+	{
+	  /// Next block in the stack
+	  BlockHeader* next=
+	    header->next;
+	  
+	  header->next=
+	    cache.freeLists[header->sizeClass];
+	  
+	  cache.freeLists[header->sizeClass]=
+	    header;
+	  
+	  header=
+	    next;
+	}
     }
     
-    /// Check if a pointer is suitably aligned
-    static bool isAligned(const void* ptr,
-			  const size_t alignment)
+    /// Marks the free list of a size class as just used
+    static void markUse(ThreadCache& cache,    ///< Cache owning the list
+			const int sizeClass)   ///< Size class of the list
     {
+      cache.lastUse[sizeClass]=
+	++cache.clock;
+    }
+    
+    /// Pop from the cache the smallest suitable block
+    ///
+    /// Returns null if no block is found
+    BlockHeader* popFromCache(ThreadCache& cache,    ///< Cache where to search
+			      const int sizeClass,   ///< Minimal size class
+			      const size_t alignment) ///< Required alignment
+    {
+      /// Last size class searched
+      const int lastSizeClass=
+	std::min(sizeClass+N_BEST_FIT_CLASSES,N_SIZE_CLASSES-1);
+      
+      for(int iClass=sizeClass;iClass<=lastSizeClass;iClass++)
+	for(BlockHeader** prev=&cache.freeLists[iClass];*prev;prev=&(*prev)->next)
+	  if(isAligned(ptrOf(*prev),alignment))
+	    {
+	      /// Result
+	      BlockHeader* header=
+		*prev;
+	      
+	      *prev=
+		header->next;
+	      
+	      markUse(cache,iClass);
+	      
+	      return
+		header;
+	    }
+      
       return
-	reinterpret_cast<uintptr_t>(ptr)%alignment==0;
+	nullptr;
     }
     
-    /// Pop from the cache, returning to use
-    void* popFromCache(const size_t& size,
-		       const size_t& alignment)
+    /// Adds a block to the cache of its owner
+    ///
+    /// A block released by another thread is pushed onto the stack of
+    /// remote frees, and accounted to the owner, which evicts the
+    /// exceeding blocks at its next release or allocation
+    void pushToCache(BlockHeader* header) ///< Block to cache
     {
-      // runLog()<<"Try to popping from cache "<<size;
+      /// Cache owning the block
+      ThreadCache& owner=
+	*header->owner;
       
-      /// List of memory with searched size
-      auto cachedIt=
-	cached.find(size);
+      /// Size of the block
+      const size_t size=
+	classSize(header->sizeClass);
       
-      if(cachedIt==cached.end())
-	return
-	  nullptr;
+      cachedSize+=
+	size;
+      
+      owner.cachedSize+=
+	size;
+      
+      if(&owner==&getThreadCache())
+	{
+	  header->next=
+	    owner.freeLists[header->sizeClass];
+	  
+	  owner.freeLists[header->sizeClass]=
+	    header;
+	  
+	  markUse(owner,header->sizeClass);
+	  
+	  if(owner.cachedSize>maxCachedSize)
+	    evictFromCache(owner);
+	}
       else
 	{
-	  /// Vector of pointers
-	  auto& list=
-	    cachedIt->second;
+	  header->next=
+	    owner.remoteFrees.load(std::memory_order_relaxed);
 	  
-	  /// Get latest cached memory with appropriate alignment
-	  auto it=
-	    list.end()-1;
+	  while(not owner.remoteFrees.compare_exchange_weak(header->next,header,std::memory_order_release,std::memory_order_relaxed))
+	    ;
+	}
+    }
+    
+    /// Evicts blocks from a cache until its size is below the maximal one
+    ///
+    /// The blocks of the least recently used size class are evicted
+    /// first. Only the thread using the cache can evict, so the cap is
+    /// enforced on each cache separately.
+    void evictFromCache(ThreadCache& cache) ///< Cache from which to evict
+    {
+      drainRemoteFrees(cache);
+      
+      while(cache.cachedSize>maxCachedSize)
+	{
+	  /// Least recently used size class with blocks
+	  int lruSizeClass=
+	    -1;
 	  
-	  while(it!=list.begin()-1 and not isAligned(*it,alignment))
-	    it--;
+	  for(int iClass=0;iClass<N_SIZE_CLASSES;iClass++)
+	    if(cache.freeLists[iClass] and (lruSizeClass==-1 or cache.lastUse[iClass]<cache.lastUse[lruSizeClass]))
+	      lruSizeClass=
+		iClass;
 	  
-	  if(it==list.begin()-1)
-	    return
-	      nullptr;
-	  else
+	  if(lruSizeClass==-1)
+	    return;
+	  
+	  /// Block to evict
+	  BlockHeader* header=
+	    cache.freeLists[lruSizeClass];
+	  
+	  cache.freeLists[lruSizeClass]=
+	    header->next;
+	  
+	  /// Size of the block
+	  const size_t size=
+	    classSize(lruSizeClass);
+	  
+	  cachedSize-=
+	    size;
+	  
+	  cache.cachedSize-=
+	    size;
+	  
+	  nEvicted++;
+	  
+	  evictedSize+=
+	    size;
+	  
+	  freeRaw(header);
+	}
+    }
+  
+  public:
+    
+    /// Sets the size above which huge pages are used
+    void setHugePagesThreshold(const size_t& threshold) ///< New threshold
+    {
+      hugePagesThreshold=
+	threshold;
+    }
+    
+    /// Enable explicit mapping from hugetlbfs for large blocks
+    ///
+    /// Huge pages must have been reserved by the system
+    /// administrator, otherwise transparent huge pages are used
+    void enableHugetlbfs()
+    {
+      useHugetlbfs=
+	true;
+    }
+    
+    /// Disable explicit mapping from hugetlbfs
+    void disableHugetlbfs()
+    {
+      useHugetlbfs=
+	false;
+    }
+    
+    /// Size of the anonymous memory of the process backed by transparent huge pages
+    ///
+    /// Read from the kernel, returns 0 if not available
+    static size_t getAnonHugePagesSize()
+    {
+      /// Result
+      size_t res=
+	0;
+      
+      if(FILE* fin=fopen("/proc/self/smaps_rollup","r"))
+	{
+	  /// Line read
+	  char line[256];
+	  
+	  while(fgets(line,sizeof(line),fin))
 	    {
-	      /// Returned pointer, copied here before erasing
-	      void* ptr=
-		*it;
-	      
-	      list.erase(it);
-	      
-	      cachedSize-=
-		size;
+	      /// Size in kB
+	      size_t sizeInKb;
 	      
-	      if(list.size()==0)
-		cached.erase(cachedIt);
-	      
-	      return
-		ptr;
+	      if(sscanf(line,"AnonHugePages: %zu kB",&sizeInKb)==1)
+		res=
+		  sizeInKb*1024;
 	    }
+	  
+	  fclose(fin);
 	}
+      
+      return
+	res;
     }
     
-    /// Move the allocated memory to cache
-    void moveToCache(void* ptr) ///< Pointer to the memory to move to cache
+    /// Sets the maximal size of cached memory of each thread
+    ///
+    /// The cap is enforced on the cache of each thread separately, so
+    /// that the total cached size can reach the maximal size times the
+    /// number of threads. If exceeded, the cache of the current thread
+    /// is immediately reduced, while the other threads reduce their
+    /// cache at their next release or allocation.
+    void setMaxCachedSize(const size_t& size) ///< Maximal size
     {
-      // runLog()<<"Moving to cache "<<ptr;
+      maxCachedSize=
+	size;
       
-      /// Size of pointed memory
-      const size_t size=
-	popFromUsed(ptr);
+      /// Cache of the thread
+      ThreadCache& cache=
+	getThreadCache();
       
-      pushToCache(ptr,size);
+      if(cache.cachedSize>maxCachedSize)
+	evictFromCache(cache);
     }
     
-  public:
+    /// Gives back to the system the physical pages of the blocks cached by the current thread
+    ///
+    /// The blocks are kept in the cache, and their pages are provided
+    /// again, filled with zero, when touched. Only the pages fully
+    /// contained in the blocks are given back, so blocks smaller than
+    /// a page are not affected. Blocks already advised since cached
+    /// are skipped. Returns the size given back.
+    size_t adviseUnneededCachedPages()
+    {
+      /// Cache of the thread
+      ThreadCache& cache=
+	getThreadCache();
+      
+      drainRemoteFrees(cache);
+      
+      /// Size of the page
+      const uintptr_t pageSize=
+	getPageSize();
+      
+      /// Size given back
+      size_t res=
+	0;
+      
+      for(int iClass=0;iClass<N_SIZE_CLASSES;iClass++)
+	for(BlockHeader* header=cache.freeLists[iClass];header;header=header->next)
+	  if(not header->advisedUnneeded)
+	    {
+	      /// Beginning of the data
+	      const uintptr_t dataBeg=
+		reinterpret_cast<uintptr_t>(ptrOf(header));
+	      
+	      /// Beginning of the first full page
+	      const uintptr_t beg=
+		(dataBeg+pageSize-1)/pageSize*pageSize;
+	      
+	      /// End of the last full page
+	      const uintptr_t end=
+		(dataBeg+classSize(iClass))/pageSize*pageSize;
+	      
+	      if(end>beg and madvise(reinterpret_cast<void*>(beg),end-beg,MADV_DONTNEED)==0)
+		{
+		  res+=
+		    end-beg;
+		  
+		  header->advisedUnneeded=
+		    true;
+		}
+	    }
+      
+      advisedUnneededSize+=
+	res;
+      
+      return
+	res;
+    }
     
     /// Enable cache usage
     void enableCache()
@@ -212,103 +904,421 @@ namespace SUNphi
       clearCache();
     }
     
+    /// Gets the tag with the given name, creating it if needed
+    ///
+    /// The lookup takes a lock, so the tag should be stored and
+    /// reused, such as:
+    ///
+    /// \code
+    /// static Memory::Tag* const tag=
+    ///   memory.getTag("gauge staples");
+    ///
+    /// double* staples=
+    ///   memory.provideAligned<double>(n,ALIGNMENT,tag);
+    /// \endcode
+    Tag* getTag(const std::string& name) ///< Name of the tag
+    {
+      ScopeMutexLocker locker(tagsMutex);
+      
+      for(Tag& tag : tags)
+	if(tag.name==name)
+	  return
+	    &tag;
+      
+      return
+	&tags.emplace_back(name);
+    }
+    
     /// Allocate or get from cache after computing the proper size
+    ///
+    /// The memory is accounted to the tag, if passed, or else to the
+    /// untagged allocations
     template <class T=char>
     T* provideAligned(const size_t nel,
-		      const size_t alignment)
+		      size_t alignment,
+		      Tag* tag=nullptr)
     {
-      /// Total size to allocate
-      const size_t size=
-	sizeof(T)*nel;
+      // The header must be aligned too
+      alignment=
+	std::max(alignment,alignof(BlockHeader));
+      
+      /// Size class needed
+      const int sizeClass=
+	sizeClassOf(sizeof(T)*nel);
       
-      /// Allocated memory
-      void* ptr;
+      /// Cache of the thread
+      ThreadCache& cache=
+	getThreadCache();
       
-      // Search in the cache
-      ptr=
-	popFromCache(size,alignment);
+      /// Allocated block
+      BlockHeader* header=
+	nullptr;
+      
+      // Search in the cache, looking also at blocks released by other threads
+      if(useCache)
+	{
+	  header=
+	    popFromCache(cache,sizeClass,alignment);
+	  
+	  if(header==nullptr and cache.remoteFrees.load(std::memory_order_relaxed)!=nullptr)
+	    {
+	      drainRemoteFrees(cache);
+	      
+	      header=
+		popFromCache(cache,sizeClass,alignment);
+	    }
+	}
       
       // If not found in the cache, allocate new memory
-      if(ptr==nullptr)
-	ptr=
-	  allocateRawAligned(size,alignment);
+      if(header==nullptr)
+	header=
+	  allocateRawAligned(sizeClass,alignment,cache);
       else
-	nCachedReused++;
+	{
+	  nCachedReused++;
+	  
+	  cachedSize-=
+	    classSize(header->sizeClass);
+	  
+	  cache.cachedSize-=
+	    classSize(header->sizeClass);
+	  
+	  header->advisedUnneeded=
+	    false;
+	}
+      
+      // Blocks released by other threads can have pushed the cache beyond the cap
+      if(cache.cachedSize>maxCachedSize)
+	evictFromCache(cache);
       
-      pushToUsed(ptr,size);
+      /// Size of the block
+      const size_t size=
+	classSize(header->sizeClass);
+      
+      usedSize+=
+	size;
+      
+      header->tag=
+	tag?tag:&tags.front();
+      
+      header->tag->usedSize+=
+	size;
+      header->tag->nAlloc++;
+      
+      cache.usedSize+=
+	size;
+      cache.nAlloc++;
       
       return
-	static_cast<T*>(ptr);
+	static_cast<T*>(ptrOf(header));
     }
     
-    /// Decleare unused the memory
-    template <class T>
-    void release(T* ptr) ///< Pointer getting freed
+    /// Size of the page
+    static uintptr_t getPageSize()
     {
-      if(useCache)
-	moveToCache(static_cast<void*>(ptr));
-      else
-	{
-	  popFromUsed(ptr);
-	  free(ptr);
-	}
+      /// Size read from the system
+      static const uintptr_t pageSize=
+	sysconf(_SC_PAGESIZE);
+      
+      return
+	pageSize;
     }
     
-    /// Release all used memory
-    void releaseAllUsedMemory()
+    /// Binds the pages of a memory region to a given NUMA node
+    ///
+    /// The pages already touched are moved to the node. Only the
+    /// pages fully contained in the region are bound, so that
+    /// neighbouring allocations are not affected. Failures are only
+    /// counted, as the binding is a matter of performance.
+    void bindToNumaNode(void* ptr,          ///< Beginning of the region
+			const size_t size,  ///< Size of the region
+			const int node)     ///< Node to which to bind
     {
-      /// Iterator on elements to release
-      auto el=
-	used.begin();
+#if defined(HAVE_LINUX_MEMPOLICY_H) and defined(SYS_mbind)
       
-      while(el!=used.end())
+      /// Size of the page
+      const uintptr_t pageSize=
+	getPageSize();
+      
+      /// Beginning of the first full page
+      const uintptr_t beg=
+	(reinterpret_cast<uintptr_t>(ptr)+pageSize-1)/pageSize*pageSize;
+      
+      /// End of the last full page
+      const uintptr_t end=
+	(reinterpret_cast<uintptr_t>(ptr)+size)/pageSize*pageSize;
+      
+      if(end<=beg)
+	return;
+      
+      /// Number of bits in each word of the mask
+      constexpr int nBitsPerWord=
+	8*sizeof(unsigned long);
+      
+      /// Mask of the node
+      Vector<unsigned long> nodeMask(node/nBitsPerWord+1,0);
+      nodeMask[node/nBitsPerWord]|=
+	1ul<<(node%nBitsPerWord);
+      
+      if(syscall(SYS_mbind,beg,end-beg,MPOL_PREFERRED,nodeMask.data(),nodeMask.size()*nBitsPerWord+1,MPOL_MF_MOVE)!=0)
+	nFailedNumaBind++;
+
+#endif
+    }
+    
+    /// Binds each chunk of the static partition of an array to the NUMA node of the owning thread
+    ///
+    /// The partition is the same used by \c ThreadPool::loopSplit, so
+    /// that loops over the array access memory local to the
+    /// thread. Nothing is done if the threads are not spread over
+    /// different NUMA nodes.
+    template <class T>
+    void bindToThreadsNumaNodes(T* ptr,           ///< Beginning of the array
+				const size_t nel) ///< Number of elements
+    {
+      if(threads.nNumaNodes()<2)
+	return;
+      
+      /// Number of threads
+      const int nThreads=
+	threads.nActiveThreads();
+      
+      for(int threadId=0;threadId<nThreads;threadId++)
 	{
-	  // runLog()<<"Releasing "<<el.first<<" size "<<el.second;
-	  
-	  /// Pointer to memory to release
-	  void* ptr=
-	    el->first;
+	  /// Chunk of the thread
+	  const LoopChunk<size_t> chunk=
+	    staticLoopChunk(size_t{0},nel,nThreads,threadId);
 	  
-	  // Increment iterator before releasing
-	  el++;
-	  
-	  release(ptr);
+	  bindToNumaNode(ptr+chunk.beg,sizeof(T)*(chunk.end-chunk.beg),threads.numaNodeOfThread(threadId));
 	}
     }
     
+    /// Check if an array is large enough to be split among the threads
+    ///
+    /// Each thread must get at least one page, otherwise the cost of
+    /// waking up the pool is not repaid
+    static bool isWorthSplittingAmongThreads(const size_t size) ///< Size of the array
+    {
+      return
+	size>=getPageSize()*threads.nActiveThreads();
+    }
+    
+    /// Executes a function on each chunk of the static partition of an array
+    ///
+    /// The partition is the same used by \c ThreadPool::loopSplit. If
+    /// the pool is waiting for work, each chunk is processed by the
+    /// thread owning it, otherwise all chunks are processed in turn by
+    /// the calling thread.
+    template <typename F>
+    static void onThreadsChunks(const size_t nel, ///< Number of elements
+				F f)              ///< Function to be called with the thread id and the chunk
+    {
+      /// Number of threads
+      const int nThreads=
+	threads.nActiveThreads();
+      
+      if(nThreads>1 and threads.getIfWaitingForWork() and threads.isMasterThread())
+	threads.workOn([nel,nThreads,&f](const int& threadId)
+		       {
+			 f(threadId,staticLoopChunk(size_t{0},nel,nThreads,threadId));
+		       });
+      else
+	for(int threadId=0;threadId<nThreads;threadId++)
+	  f(threadId,staticLoopChunk(size_t{0},nel,nThreads,threadId));
+    }
+    
+    /// Touches for the first time an array, with each chunk of the static partition touched by the owning thread
+    ///
+    /// On first touch the kernel places each page on the NUMA node of
+    /// the touching thread, so that loops over the array access memory
+    /// local to the thread. One byte per page is written, the content
+    /// of the array being undefined anyway. Each page is touched by the
+    /// thread owning its beginning. Nothing is done if disabled.
+    template <class T>
+    void firstTouchInParallel(T* ptr,           ///< Beginning of the array
+			      const size_t nel) ///< Number of elements
+    {
+      if(not useParallelFirstTouch or not isWorthSplittingAmongThreads(sizeof(T)*nel))
+	return;
+      
+      /// Size of the page
+      const uintptr_t pageSize=
+	getPageSize();
+      
+      onThreadsChunks(nel,[ptr,pageSize](const int& threadId,const LoopChunk<size_t>& chunk)
+		      {
+			/// Beginning of the chunk
+			const uintptr_t beg=
+			  reinterpret_cast<uintptr_t>(ptr+chunk.beg);
+			
+			/// End of the chunk
+			const uintptr_t end=
+			  reinterpret_cast<uintptr_t>(ptr+chunk.end);
+			
+			// The page containing the beginning belongs to the previous thread, unless this is the first
+			for(uintptr_t page=(threadId==0)?beg:(beg+pageSize-1)/pageSize*pageSize;page<end;page=(page/pageSize+1)*pageSize)
+			  *reinterpret_cast<volatile char*>(page)=
+			    0;
+		      });
+    }
+    
+    /// Copies an array, with each chunk of the static partition copied by the owning thread
+    ///
+    /// Each thread copies a contiguous chunk, which is vectorized by
+    /// the standard library for trivially copyable types. Small
+    /// arrays are copied by the calling thread alone.
+    template <class T>
+    static void copyInParallel(T* dst,           ///< Destination
+			       const T* src,     ///< Source
+			       const size_t nel) ///< Number of elements
+    {
+      if(not isWorthSplittingAmongThreads(sizeof(T)*nel))
+	std::copy(src,src+nel,dst);
+      else
+	onThreadsChunks(nel,[dst,src](const int& threadId,const LoopChunk<size_t>& chunk)
+			{
+			  std::copy(src+chunk.beg,src+chunk.end,dst+chunk.beg);
+			});
+    }
+    
+    /// Enable the parallel first touch of the allocated memory
+    void enableParallelFirstTouch()
+    {
+      useParallelFirstTouch=
+	true;
+    }
+    
+    /// Disable the parallel first touch of the allocated memory
+    void disableParallelFirstTouch()
+    {
+      useParallelFirstTouch=
+	false;
+    }
+    
+    /// Decleare unused the memory
+    template <class T>
+    void release(T* ptr) ///< Pointer getting freed
+    {
+      /// Header of the block
+      BlockHeader* header=
+	headerOf(static_cast<void*>(ptr));
+      
+      /// Size of the block
+      const size_t size=
+	classSize(header->sizeClass);
+      
+      usedSize-=
+	size;
+      
+      header->tag->usedSize-=
+	size;
+      
+      header->owner->usedSize-=
+	size;
+      
+      if(useCache)
+	pushToCache(header);
+      else
+	freeRaw(header);
+    }
+    
     /// Release all memory from cache
+    ///
+    /// Must be called when no other thread is using the memory manager
     void clearCache()
     {
-      /// Iterator to elements of the cached memory list
-      auto el=
-	cached.begin();
+      ScopeMutexLocker locker(threadCachesMutex);
       
-      while(el!=cached.end())
+      for(ThreadCache& cache : threadCaches)
 	{
-	  /// Number of elements to free
-	  const size_t n=
-	    el->second.size();
-	  
-	  /// Size to be removed
-	  const size_t size=
-	    el->first;
+	  drainRemoteFrees(cache);
 	  
-	  // Increment before erasing
-	  el++;
-	  
-	  for(size_t i=0;i<n;i++)
-	    {
-	      // runLog()<<"Removing from cache size "<<el.first;
-	      
-	      /// Memory to free
-	      void* ptr=
-		popFromCache(size,DEFAULT_ALIGNMENT);
-	      
-	      free(ptr);
-	    }
+	  for(BlockHeader*& freeList : cache.freeLists)
+	    while(freeList)
+	      {
+		// runLog()<<"Removing from cache size "<<classSize(freeList->sizeClass);
+		
+		/// Block to free
+		BlockHeader* header=
+		  freeList;
+		
+		freeList=
+		  header->next;
+		
+		cachedSize-=
+		  classSize(header->sizeClass);
+		
+		cache.cachedSize-=
+		  classSize(header->sizeClass);
+		
+		freeRaw(header);
+	      }
 	}
     }
     
+    /// Size of the memory currently used
+    size_t getUsedSize()
+      const
+    {
+      return
+	usedSize;
+    }
+    
+    /// Size of the memory currently cached
+    size_t getCachedSize()
+      const
+    {
+      return
+	cachedSize;
+    }
+    
+    /// Size of the memory currently cached by the current thread
+    size_t getThreadCachedSize()
+    {
+      return
+	getThreadCache().cachedSize;
+    }
+    
+    /// Size of the memory given back to the system from the cache
+    size_t getAdvisedUnneededSize()
+      const
+    {
+      return
+	advisedUnneededSize;
+    }
+    
+    /// Number of blocks evicted from the cache
+    size_t getNEvicted()
+      const
+    {
+      return
+	nEvicted;
+    }
+    
+    /// Number of allocations advised to use transparent huge pages
+    size_t getNHugePagesAlloc()
+      const
+    {
+      return
+	nHugePagesAlloc;
+    }
+    
+    /// Size currently allocated advising to use transparent huge pages
+    size_t getHugePagesSize()
+      const
+    {
+      return
+	hugePagesSize;
+    }
+    
+    /// Size above which huge pages are used
+    size_t getHugePagesThreshold()
+      const
+    {
+      return
+	hugePagesThreshold;
+    }
+    
     /// Print to a stream
     template <typename T>
     auto& printStatistics(T&& stream)
@@ -317,16 +1327,86 @@ namespace SUNphi
 	stream<<"Maximal memory used: "<<usedSize.extreme()<<" bytes, currently used: "<<usedSize
 	      <<" bytes, number of allocation: "<<nUnalignedAlloc<<" unaligned, "<<nAlignedAlloc<<" aligned\n"
 	      <<"Maximal memory cached: "<<cachedSize.extreme()<<" bytes, currently used: "<<cachedSize
-	      <<" bytes, number of reused: "<<nCachedReused;
+	      <<" bytes, number of reused: "<<nCachedReused
+	      <<", number of failed binding to NUMA nodes: "<<nFailedNumaBind
+	      <<", number of thread caches: "<<threadCaches.size()<<"\n"
+	      <<"Maximal cached size: "<<maxCachedSize<<" bytes, number of evicted: "<<nEvicted<<", evicted size: "<<evictedSize
+	      <<" bytes, cached size given back to the system: "<<advisedUnneededSize<<" bytes\n"
+	      <<"Blocks larger than "<<hugePagesThreshold<<" bytes: "<<nHugePagesAlloc<<" allocated with transparent huge pages, currently "<<hugePagesSize
+	      <<" bytes (maximal "<<hugePagesSize.extreme()<<"), "<<nHugetlbfsAlloc<<" mapped from hugetlbfs, currently "<<hugetlbfsSize
+	      <<" bytes (maximal "<<hugetlbfsSize.extreme()<<"), "<<nFailedHugetlbfsAlloc<<" failed hugetlbfs mappings; "
+	      <<getAnonHugePagesSize()<<" bytes of the process backed by huge pages";
+    }
+    
+    /// Usage of memory by each tag
+    Vector<Usage> getUsageByTag()
+    {
+      ScopeMutexLocker locker(tagsMutex);
+      
+      /// Result
+      Vector<Usage> res;
+      
+      for(const Tag& tag : tags)
+	res.push_back({tag.name,tag.usedSize,tag.usedSize.extreme(),tag.nAlloc});
+      
+      return
+	res;
+    }
+    
+    /// Usage of memory by each thread cache
+    ///
+    /// The memory is accounted to the thread which allocated it, even
+    /// if released by another one
+    Vector<Usage> getUsageByThread()
+    {
+      ScopeMutexLocker locker(threadCachesMutex);
+      
+      /// Result
+      Vector<Usage> res;
+      
+      for(const ThreadCache& cache : threadCaches)
+	res.push_back({"thread cache "+std::to_string(res.size()),cache.usedSize,cache.usedSize.extreme(),cache.nAlloc});
+      
+      return
+	res;
+    }
+    
+    /// Print to a stream the memory used by each tag and thread
+    ///
+    /// Can be called at any time, such as:
+    ///
+    /// \code
+    /// memory.printUsageReport(runLog());
+    /// \endcode
+    template <typename T>
+    auto& printUsageReport(T&& stream)
+    {
+      stream<<"Memory used by tag:";
+      
+      for(const Usage& usage : getUsageByTag())
+	stream<<"\n "<<usage.name<<": "<<usage.size<<" bytes (maximal "<<usage.maxSize<<"), "<<usage.nAlloc<<" allocations";
+      
+      stream<<"\nMemory used by thread:";
+      
+      for(const Usage& usage : getUsageByThread())
+	stream<<"\n "<<usage.name<<": "<<usage.size<<" bytes (maximal "<<usage.maxSize<<"), "<<usage.nAlloc<<" allocations";
+      
+      return
+	stream;
     }
     
     /// Create the memory manager
     Memory()
     {
       runLog()<<"Starting the memory manager";
+      
+      tags.emplace_back("untagged");
     }
     
     /// Destruct the memory manager
+    ///
+    /// Blocks still in use are not freed, as they could be released
+    /// later by objects destroyed after the memory manager
     ~Memory()
     {
       runLog()<<"Stopping the memory manager";
@@ -335,9 +1415,14 @@ namespace SUNphi
       
       printStatistics(runLog());
       
-      releaseAllUsedMemory();
+      printUsageReport(runLog());
       
       clearCache();
+      
+      // Detach the current thread from caches being destroyed
+      if(threadCacheHandle.cache and threadCacheHandle.cache->memory==this)
+	threadCacheHandle.cache=
+	  nullptr;
     }
   };
   
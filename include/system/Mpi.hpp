@@ -14,6 +14,8 @@
  #include <mpi.h>
 #endif
 
+#include <functional>
+
 #include <ios/MinimalLogger.hpp>
 #include <metaprogramming/TypeTraits.hpp>
 #include <system/Timer.hpp>
@@ -50,6 +52,8 @@ namespace SUNphi
   
   PROVIDE_MPI_DATATYPE(MPI_INT,int);
   
+  PROVIDE_MPI_DATATYPE(MPI_INT64_T,int64_t);
+  
   PROVIDE_MPI_DATATYPE(MPI_DOUBLE,double);
 #endif
   
@@ -259,6 +263,30 @@ namespace SUNphi
       
     }
     
+    /// Reduces a loop split among the threads, and then among all MPI process
+    ///
+    /// The values returned by \c f are summed over the local range
+    /// through \c ThreadPool::loopSplitReduce, and the result is
+    /// summed over all ranks with \c allReduce
+    template <LoopScheduling Sched=LoopScheduling::STATIC, // Scheduling policy
+	      typename Size,                                // Type for the range of the loop
+	      typename T,                                   // Type of the result
+	      typename F>                                   // Type for the work function
+    T loopSplitAllReduce(const Size& beg,                               ///< Beginning of the local loop
+			 const Size& end,                               ///< End of the local loop
+			 const T& zero,                                 ///< Null value of the sum
+			 F f,                                           ///< Function to be called, accepting the thread id and the loop argument, returning the value to be summed
+			 const std::common_type_t<Size>& chunkSize=0)   ///< Size of the chunks, not used to deduce \c Size
+      const
+    {
+      /// Result on the local rank
+      const T localRes=
+	threads.loopSplitReduce<Sched>(beg,end,zero,f,std::plus<T>(),chunkSize);
+      
+      return
+	allReduce(localRes);
+    }
+    
     /// Broadcast among all MPI process
     ///
     /// This is a simple wrapper around the MPI_Bcast function
@@ -4,23 +4,89 @@
 /// \file SIMD.hpp
 ///
 /// \brief Header file for Same Instruction Different Data instructions and types
+///
+/// Each instruction set providing SIMD vectors is a backend, with its
+/// own width. The backend enabled at compile time is the default
+/// one. If \c USE_SIMD_DISPATCH is defined, the kernels are compiled
+/// also for the wider backends, and the best one supported by the
+/// machine is chosen at runtime. In this way a single binary compiled
+/// for a generic x86-64 runs at full width on both AVX2 and AVX-512
+/// machines.
+
+#ifdef HAVE_CONFIG_H
+ #include <config.hpp>
+#endif
 
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <type_traits>
 
 #include <utility/Unused.hpp>
 
 namespace SUNphi
 {
-  /// Basic alignement for AVX-512, to be generalized
+  /// Instruction sets providing SIMD vectors, ordered by width
+  enum class SIMDBackend{SCALAR,   ///< No instruction set, the compiler lowers vectors to scalar instructions
+			 SSE2,     ///< 128 bit vectors
+			 AVX2,     ///< 256 bit vectors, with fused multiply-add
+			 AVX512};  ///< 512 bit vectors, with fused multiply-add
+  
+  /// Properties of a SIMD backend
+  template <SIMDBackend B>  // Backend
+  struct SIMDBackendProps;
+  
+  /// Provides the properties of a SIMD backend
+#define PROVIDE_SIMD_BACKEND_PROPS(BACKEND,   /*!< Backend                    */ \
+				   SIZE)      /*!< Size of the vector in bytes */ \
+  /*! Properties of the BACKEND SIMD backend */				\
+  template <>								\
+  struct SIMDBackendProps<SIMDBackend::BACKEND>				\
+  {									\
+    /*! Size of the vector in bytes */					\
+    static constexpr size_t size=					\
+      SIZE;								\
+									\
+    /*! Name of the backend */						\
+    static constexpr const char* name=					\
+      #BACKEND;								\
+  }
+  
+  // Vectors of the scalar backend are large enough to contain a double complex
+  PROVIDE_SIMD_BACKEND_PROPS(SCALAR,16);
+  PROVIDE_SIMD_BACKEND_PROPS(SSE2,16);
+  PROVIDE_SIMD_BACKEND_PROPS(AVX2,32);
+  PROVIDE_SIMD_BACKEND_PROPS(AVX512,64);
+
+#undef PROVIDE_SIMD_BACKEND_PROPS
+  
+  /// Backend enabled at compile time
+  static constexpr SIMDBackend COMPILE_TIME_SIMD_BACKEND=
+#if defined(__AVX512F__)
+    SIMDBackend::AVX512;
+#elif defined(__AVX2__) and defined(__FMA__)
+    SIMDBackend::AVX2;
+#elif defined(__SSE2__)
+    SIMDBackend::SSE2;
+#else
+    SIMDBackend::SCALAR;
+#endif
+  MAYBE_UNUSED(COMPILE_TIME_SIMD_BACKEND);
+  
+  /// Alignment suitable for all backends
+  ///
+  /// The widest backend is used, so that memory can be accessed by
+  /// the backend chosen at runtime
   static constexpr size_t ALIGNMENT=
-    64;
+    SIMDBackendProps<SIMDBackend::AVX512>::size;
   MAYBE_UNUSED(ALIGNMENT);
   
   /// Number of components of a SIMD vector of type F
-  template <typename F> // Fundamental type
+  template <typename F,                             // Fundamental type
+	    SIMDBackend B=COMPILE_TIME_SIMD_BACKEND>  // Backend
   [[ maybe_unused ]]
   constexpr int NSIMD_COMPONENTS=
-    ALIGNMENT/sizeof(F);
+    SIMDBackendProps<B>::size/sizeof(F);
   
   /// Check if a certain number can be the size of a SIMD vector
   template <typename F>                                 //   Fundamental type
@@ -35,6 +101,340 @@ namespace SUNphi
   {
     return size>=0 and (NSIMD_COMPONENTS<F>%size)==0;
   }
+  
+  /// Detects the widest backend supported by the machine
+  ///
+  /// Backends narrower than the compile-time one are never returned,
+  /// as the rest of the code cannot run without it anyway
+  inline SIMDBackend detectSIMDBackend()
+  {
+#if defined(USE_SIMD_DISPATCH) and (defined(__x86_64__) or defined(__i386__))
+    // Needed if called by a static initializer
+    __builtin_cpu_init();
+    
+    if(__builtin_cpu_supports("avx512f"))
+      return
+	SIMDBackend::AVX512;
+    
+    if(COMPILE_TIME_SIMD_BACKEND<SIMDBackend::AVX512 and
+       __builtin_cpu_supports("avx2") and
+       __builtin_cpu_supports("fma"))
+      return
+	SIMDBackend::AVX2;
+#endif
+    
+    return
+      COMPILE_TIME_SIMD_BACKEND;
+  }
+  
+  /// Returns the name of a backend
+  inline const char* simdBackendName(const SIMDBackend b)  ///< Backend
+  {
+    switch(b)
+      {
+      case SIMDBackend::SCALAR:
+	return SIMDBackendProps<SIMDBackend::SCALAR>::name;
+      case SIMDBackend::SSE2:
+	return SIMDBackendProps<SIMDBackend::SSE2>::name;
+      case SIMDBackend::AVX2:
+	return SIMDBackendProps<SIMDBackend::AVX2>::name;
+      case SIMDBackend::AVX512:
+	return SIMDBackendProps<SIMDBackend::AVX512>::name;
+      }
+    
+    return
+      "unknown";
+  }
+  
+  /// Backend chosen at runtime, defined in the library
+  extern const SIMDBackend simdBackend;
+  
+  /// Tag type identifying a backend
+  template <SIMDBackend B>  // Backend
+  using SIMDBackendTag=
+    std::integral_constant<SIMDBackend,B>;
+  
+  /// Calls f passing the tag of the backend, with the code compiled for the backend
+  ///
+  /// The function is flattened, so that all the calls issued by f
+  /// are inlined and compiled for the instruction set of the
+  /// backend. Backends not wider than the compile-time one need no
+  /// specific target.
+#define PROVIDE_CALL_WITH_SIMD_BACKEND(BACKEND,ATTRIBUTES)		\
+  /*! Calls f with the BACKEND backend */				\
+  template <typename F>		         /* Type of the function */	\
+  ATTRIBUTES								\
+  void callWithSIMDBackend(SIMDBackendTag<SIMDBackend::BACKEND>, /*!< Backend */ \
+			   F&& f)        /*!< Function to call    */	\
+  {									\
+    f(SIMDBackendTag<SIMDBackend::BACKEND>{});				\
+  }
+  
+  PROVIDE_CALL_WITH_SIMD_BACKEND(SCALAR,);
+  PROVIDE_CALL_WITH_SIMD_BACKEND(SSE2,);
+#if defined(__x86_64__) or defined(__i386__)
+  PROVIDE_CALL_WITH_SIMD_BACKEND(AVX2,__attribute__((target("avx2,fma"),flatten)));
+  PROVIDE_CALL_WITH_SIMD_BACKEND(AVX512,__attribute__((target("avx512f,fma"),flatten)));
+#endif
+
+#undef PROVIDE_CALL_WITH_SIMD_BACKEND
+  
+  /// Calls f passing the tag of the backend chosen at runtime
+  ///
+  /// Only the compile-time backend is used if the dispatch is not
+  /// enabled. Example:
+  ///
+  /// \code
+  /// dispatchSIMDBackend([&](auto backend)
+  ///                     {
+  ///                       using Pack=SIMDPack<double,decltype(backend)::value>;
+  ///                       ...
+  ///                     });
+  /// \endcode
+  template <typename F>  // Type of the function
+  void dispatchSIMDBackend(F&& f) ///< Function to call
+  {
+#if defined(USE_SIMD_DISPATCH) and (defined(__x86_64__) or defined(__i386__))
+    if constexpr(COMPILE_TIME_SIMD_BACKEND<SIMDBackend::AVX512)
+      if(simdBackend==SIMDBackend::AVX512)
+	return
+	  callWithSIMDBackend(SIMDBackendTag<SIMDBackend::AVX512>{},f);
+    
+    if constexpr(COMPILE_TIME_SIMD_BACKEND<SIMDBackend::AVX2)
+      if(simdBackend==SIMDBackend::AVX2)
+	return
+	  callWithSIMDBackend(SIMDBackendTag<SIMDBackend::AVX2>{},f);
+#endif
+    
+    callWithSIMDBackend(SIMDBackendTag<COMPILE_TIME_SIMD_BACKEND>{},f);
+  }
+  
+  /// Pack of values of type F, filling a SIMD vector
+  ///
+  /// The operations are expressed through the vector extension of the
+  /// compiler, so that each of them is translated into a full-width
+  /// instruction of the target, when compiled for the backend B. Complex
+  /// numbers are stored with real and imaginary part interleaved, so
+  /// that a pack contains NSIMD_COMPONENTS/2 of them.
+  template <typename F,                             // Fundamental type
+	    SIMDBackend B=COMPILE_TIME_SIMD_BACKEND>  // Backend
+  struct SIMDPack
+  {
+    /// Number of components
+    static constexpr int nComps=
+      NSIMD_COMPONENTS<F,B>;
+    
+    /// Vector type of the compiler
+    typedef F Vec __attribute__((vector_size(sizeof(F)*nComps)));
+    
+    /// Signed integer with the same size of F, used to shuffle
+    using Int=
+      std::conditional_t<sizeof(F)==8,int64_t,int32_t>;
+    
+    /// Vector of integers used to shuffle
+    typedef Int IntVec __attribute__((vector_size(sizeof(F)*nComps)));
+    
+    /// Data
+    Vec v;
+    
+    /// Loads a pack from consecutive values, not necessarily aligned
+    static SIMDPack load(const F* ptr)  ///< Beginning of the values
+    {
+      /// Result
+      SIMDPack res;
+      
+      memcpy(&res.v,ptr,sizeof(Vec));
+      
+      return
+	res;
+    }
+    
+    /// Loads a pack from values separated by a stride
+    template <typename S>        // Type of the stride
+    static SIMDPack gather(const F* ptr,     ///< Beginning of the values
+			   const S& stride)  ///< Distance between the values
+    {
+      /// Result
+      SIMDPack res;
+      
+      for(int i=0;i<nComps;i++)
+	res.v[i]=
+	  ptr[i*stride];
+      
+      return
+	res;
+    }
+    
+    /// Pack with all components equal to a value
+    static SIMDPack broadcast(const F& f)  ///< Value to broadcast
+    {
+      /// Result
+      SIMDPack res;
+      
+      res.v=
+	Vec{}+f;
+      
+      return
+	res;
+    }
+    
+    /// Stores the pack into consecutive values, not necessarily aligned
+    void store(F* ptr)  ///< Beginning of the values
+      const
+    {
+      memcpy(ptr,&v,sizeof(Vec));
+    }
+    
+    /// Stores the pack into values separated by a stride
+    template <typename S>        // Type of the stride
+    void scatter(F* ptr,           ///< Beginning of the values
+		 const S& stride)  ///< Distance between the values
+      const
+    {
+      for(int i=0;i<nComps;i++)
+	ptr[i*stride]=
+	  v[i];
+    }
+    
+    /// Returns a component
+    F operator[](const int& i)  ///< Component to get
+      const
+    {
+      return
+	v[i];
+    }
+    
+    /// Defines a binary operator acting component by component
+#define PROVIDE_SIMD_PACK_BINARY_OPERATOR(OP)				\
+    /*! Applies OP to each component */					\
+    friend SIMDPack operator OP(const SIMDPack& a,  /*!< First operand  */ \
+				const SIMDPack& b)  /*!< Second operand */ \
+    {									\
+      return								\
+	{a.v OP b.v};							\
+    }
+    
+    PROVIDE_SIMD_PACK_BINARY_OPERATOR(+);
+    PROVIDE_SIMD_PACK_BINARY_OPERATOR(-);
+    PROVIDE_SIMD_PACK_BINARY_OPERATOR(*);
+    PROVIDE_SIMD_PACK_BINARY_OPERATOR(/);
+
+#undef PROVIDE_SIMD_PACK_BINARY_OPERATOR
+    
+    /// Returns the opposite
+    friend SIMDPack operator-(const SIMDPack& a)  ///< Pack to negate
+    {
+      return
+	{-a.v};
+    }
+    
+    /// Returns the pack itself
+    friend SIMDPack operator+(const SIMDPack& a)  ///< Pack to return
+    {
+      return
+	a;
+    }
+    
+    /// Fused multiply-add, a*b+c
+    ///
+    /// The expression is contracted into a single instruction by the
+    /// compiler when the target supports it
+    friend SIMDPack fma(const SIMDPack& a,  ///< First factor
+			const SIMDPack& b,  ///< Second factor
+			const SIMDPack& c)  ///< Addend
+    {
+      return
+	{a.v*b.v+c.v};
+    }
+    
+    /// Shuffles the components, taking in position i the component m(i)
+    ///
+    /// The mask is not returned by value from a function, as the
+    /// wide vector would be returned with a different ABI in the code
+    /// not compiled for the backend
+    template <typename M>            // Type of the function
+    SIMDPack shuffled(M m)  ///< Function computing the source of each component
+      const
+    {
+      /// Mask
+      IntVec mask;
+      
+      for(int i=0;i<nComps;i++)
+	mask[i]=
+	  m(i);
+      
+      return
+	{__builtin_shuffle(v,mask)};
+    }
+    
+    /// Swaps real and imaginary part of each complex number
+    SIMDPack swapReIm()
+      const
+    {
+      return
+	shuffled([](const int i){return i^1;});
+    }
+    
+    /// Replaces the imaginary part of each complex number with the real one
+    SIMDPack dupRe()
+      const
+    {
+      return
+	shuffled([](const int i){return i&~1;});
+    }
+    
+    /// Replaces the real part of each complex number with the imaginary one
+    SIMDPack dupIm()
+      const
+    {
+      return
+	shuffled([](const int i){return i|1;});
+    }
+    
+    /// Pack with -1 on the real parts and +1 on the imaginary ones
+    static SIMDPack minusRePlusIm()
+    {
+      /// Result
+      SIMDPack res;
+      
+      for(int i=0;i<nComps;i++)
+	res.v[i]=
+	  (i%2)?+1:-1;
+      
+      return
+	res;
+    }
+    
+    /// Conjugate of each complex number
+    friend SIMDPack conj(const SIMDPack& a)  ///< Pack to conjugate
+    {
+      return
+	{-a.v*minusRePlusIm().v};
+    }
+    
+    /// Product of each pair of complex numbers
+    ///
+    /// The product is computed as
+    ///
+    /// \code
+    /// (a_re,a_re)*(b_re,b_im)+(a_im,a_im)*(-b_im,b_re)
+    /// \endcode
+    friend SIMDPack complMul(const SIMDPack& a,  ///< First factor
+			     const SIMDPack& b)  ///< Second factor
+    {
+      return
+	fma(a.dupIm(),b.swapReIm()*minusRePlusIm(),a.dupRe()*b);
+    }
+    
+    /// Product of each pair of complex numbers, summed to a third one
+    friend SIMDPack complFma(const SIMDPack& a,  ///< First factor
+			     const SIMDPack& b,  ///< Second factor
+			     const SIMDPack& c)  ///< Addend
+    {
+      return
+	fma(a.dupIm(),b.swapReIm()*minusRePlusIm(),fma(a.dupRe(),b,c));
+    }
+  };
 }
 
 #endif
@@ -0,0 +1,181 @@
+#ifndef _SHAREDBUFFER_HPP
+#define _SHAREDBUFFER_HPP
+
+/// \file SharedBuffer.hpp
+///
+/// \brief Reference-counted ownership of the buffer of a tensor storage
+///
+/// All the storages referring to the same buffer, such as the
+/// component-merged views of a tensor, share a control block counting
+/// the references. The buffer is released when the last reference is
+/// dropped, so that views can outlive the storage from which they are
+/// obtained. Creating a view costs only an atomic increment, the
+/// control block being allocated once per buffer.
+
+#include <atomic>
+#include <utility>
+
+#include <ios/MappedFile.hpp>
+#include <system/Memory.hpp>
+
+namespace SUNphi
+{
+  /// Shared ownership of a buffer, either provided by the memory manager or mapped from a file
+  class SharedBuffer
+  {
+    /// Control block, shared among all the references
+    struct Control
+    {
+      /// Number of references
+      std::atomic<int> nRefs{1};
+      
+      /// Buffer provided by the memory manager, if any
+      void* data{nullptr};
+      
+      /// File mapped as buffer, if any
+      MappedFile mappedFile;
+    };
+    
+    /// Control block, null if no buffer is owned
+    Control* control{nullptr};
+    
+    /// Drops the reference, releasing the buffer if it was the last one
+    void unref()
+    {
+      if(control and control->nRefs.fetch_sub(1,std::memory_order_acq_rel)==1)
+	{
+	  if(control->data)
+	    memory.release(control->data);
+	  
+	  // The mapped file, if any, is unmapped by its destructor
+	  delete control;
+	}
+      
+      control=
+	nullptr;
+    }
+  
+  public:
+    
+    /// Check if a buffer is owned
+    bool isOwning()
+      const
+    {
+      return
+	control!=nullptr;
+    }
+    
+    /// Number of references to the buffer, zero if no buffer is owned
+    int nRefs()
+      const
+    {
+      return
+	control?control->nRefs.load(std::memory_order_relaxed):0;
+    }
+    
+    /// Asks the kernel to read in advance the buffer, if mapped from a file
+    void prefetch()
+      const
+    {
+      if(control)
+	control->mappedFile.prefetch();
+    }
+    
+    /// Takes the ownership of a buffer provided by the memory manager
+    static SharedBuffer ofMemory(void* data) ///< Buffer to own
+    {
+      /// Result
+      SharedBuffer res;
+      
+      res.control=
+	new Control;
+      
+      res.control->data=
+	data;
+      
+      return
+	res;
+    }
+    
+    /// Takes the ownership of a mapped file
+    static SharedBuffer ofMappedFile(MappedFile&& mappedFile) ///< File to own
+    {
+      /// Result
+      SharedBuffer res;
+      
+      res.control=
+	new Control;
+      
+      res.control->mappedFile=
+	std::move(mappedFile);
+      
+      return
+	res;
+    }
+    
+    /// Default constructor, not owning anything
+    SharedBuffer()
+    {
+    }
+    
+    /// Copy constructor, adding a reference
+    SharedBuffer(const SharedBuffer& oth) :
+      control(oth.control)
+    {
+      if(control)
+	control->nRefs.fetch_add(1,std::memory_order_relaxed);
+    }
+    
+    /// Move constructor, taking the reference
+    SharedBuffer(SharedBuffer&& oth) :
+      control(oth.control)
+    {
+      oth.control=
+	nullptr;
+    }
+    
+    /// Copy assignment, dropping the previous reference
+    SharedBuffer& operator=(const SharedBuffer& oth)
+    {
+      if(control!=oth.control)
+	{
+	  unref();
+	  
+	  control=
+	    oth.control;
+	  
+	  if(control)
+	    control->nRefs.fetch_add(1,std::memory_order_relaxed);
+	}
+      
+      return
+	*this;
+    }
+    
+    /// Move assignment, dropping the previous reference
+    SharedBuffer& operator=(SharedBuffer&& oth)
+    {
+      if(this!=&oth)
+	{
+	  unref();
+	  
+	  control=
+	    oth.control;
+	  
+	  oth.control=
+	    nullptr;
+	}
+      
+      return
+	*this;
+    }
+    
+    /// Destructor, dropping the reference
+    ~SharedBuffer()
+    {
+      unref();
+    }
+  };
+}
+
+#endif
@@ -21,12 +21,16 @@ namespace SUNphi
   ///
   /// Container with a given TensKind structure and fundamental type,
   /// holding resources for the storage of the data and providing
-  /// evaluator
-  template <typename TK,   // List of tensor components
-	    typename FUND> // Fundamental type
+  /// evaluator. The elements are indexed with type \c IDX, see \c
+  /// TensIdx for the default. Views on tensors whose data is kept
+  /// inside the storage are marked by \c IS_VIEW, see \c TensStor.
+  template <typename TK,             // List of tensor components
+	    typename FUND,           // Fundamental type
+	    typename IDX=TensIdx,    // Type used to index
+	    bool IS_VIEW=false>      // Mark whether the storage is a view on inline data
   class Tens :
-    public BaseTens,                       // Inherit from BaseTens to detect in expression
-    public NnarySmET<Tens<TK,FUND>>,       // Inherit from NnarySmET
+    public BaseTens,                               // Inherit from BaseTens to detect in expression
+    public NnarySmET<Tens<TK,FUND,IDX,IS_VIEW>>,   // Inherit from NnarySmET
     public ConstrainIsTensKind<TK>,        // Constrain the TK type to be a TensKind
     public ConstrainIsFloatingPoint<FUND>  // Constrain the Fund type to be a floating point
   {
@@ -38,19 +42,24 @@ namespace SUNphi
     /// Tensor fundamental type of the tensor
     PROVIDE_FUND(FUND);
     
+    /// Type used to index
+    using Idx=
+      IDX;
+    
     // Attributes
     ASSIGNABLE;
     STORING;
-    IS_ALIASING_ACCORDING_TO_POINTER(v);
+    PROVIDE_IS_ALIASING(/*! Check whether the storage overlaps with the passed one */,
+			return v.overlapsWith(alias););
     
   private:
     
-    /// Internal storage, inited to null
-    TensStor<Tk,Fund>* v=
-      nullptr;
+    /// Type of the storage
+    using Stor=
+      TensStor<Tk,Fund,Idx,IS_VIEW>;
     
-    /// Keep note of whether we need to free at destroy
-    bool freeAtDestroy;
+    /// Internal storage, sharing the buffer with views
+    Stor v;
     
   public:
     
@@ -58,17 +67,16 @@ namespace SUNphi
     
     /// Returns the size of a component
     template <typename TC>  // Name of the component
-    int compSize() const
+    Idx compSize() const
     {
-      return v->template compSize<TC>();
+      return v.template compSize<TC>();
     }
     
     /// Construct the Tens on the basis of the dynamical sizes passed
     template <class...DynSizes,                                               //   Dynamic size types
 	      typename=EnableIf<areIntegrals<Unqualified<DynSizes>...>>>      //   Constrain to be integers
     explicit Tens(DynSizes&&...extDynSizes) :                    ///< Passed internal dynamic size
-      v(new TensStor<Tk,Fund>(forw<DynSizes>(extDynSizes)...)),  //   Construct the vector
-      freeAtDestroy(true)                                        //   We are allocating, so we need to free
+      v(forw<DynSizes>(extDynSizes)...)                          //   Construct the vector
     {
 #ifdef DEBUG_TENS
       using namespace std;
@@ -78,43 +86,85 @@ namespace SUNphi
     }
     
     /// Construct the Tens on the basis of a reference storage
-    explicit Tens(TensStor<Tk,Fund>* v) :                        ///< Provided storage
-      v(v),                       // The internal storage is built with the reference
-      freeAtDestroy(false)        // We are not allocating, so we need not to free
+    ///
+    /// The tensor is a view on the storage, sharing its buffer
+    template <bool OthIsView>                                      // Mark whether the storage is a view
+    explicit Tens(TensStor<Tk,Fund,Idx,OthIsView>* v) :            ///< Provided storage
+      v(v->view())                // The internal storage is built with the reference
     {
+      static_assert(std::is_same_v<typename TensStor<Tk,Fund,Idx,OthIsView>::View,Stor>,
+		    "Views of data kept inside the storage must be of type Tens<Tk,Fund,Idx,true>");
+      
 #ifdef DEBUG_TENS
       using namespace std;
       cout<<"Creating a Tens of type "<<Tk::name()<<" NOT allocating"<<endl;
 #endif
     }
     
-//     /// Copy constructor
-//     Tens(const Tens& oth) :
-//       v(new TensStor<Tk,Fund>(*oth.v)),   //   Copy the vector
-//       freeAtDestroy(true)                 //   We are allocating, so we need
-//     {
-//       printf("Copying a Tens of type %s NOT allocating\n",Tk::name());
-// #ifdef DEBUG_TENS
-//       using namespace std;
-//       cout<<"Tens copy constructor!"<<endl;
-// #endif
-//     }
-    
-    /// Move constructor
-//     Tens(Tens&& oth) : freeAtDestroy(oth.freeAtDestroy) // Deallocate according to arg
-//     {
-//       oth.freeAtDestroy=false;
-      
-//       v=oth.v;
-//       oth.v=nullptr;
+    /// Construct the Tens taking a storage
+    explicit Tens(Stor&& v) :                                    ///< Provided storage
+      v(std::move(v))
+    {
+    }
+    
+    /// Copy constructor, copying the content into a new storage
+    ///
+    /// Views sharing the storage are obtained through \c
+    /// getMergedCompsView
+    Tens(const Tens& oth) :
+      v(oth.v)
+    {
+#ifdef DEBUG_TENS
+      using namespace std;
+      cout<<"Tens copy constructor!"<<endl;
+#endif
+    }
+    
+    /// Move constructor, taking the storage
+    Tens(Tens&& oth) :
+      v(std::move(oth.v))
+    {
+#ifdef DEBUG_TENS
+      using namespace std;
+      cout<<"Tens move constructor!"<<endl;
+#endif
+    }
+    
+    /// Copy assignment, copying the content into the present storage
+    ///
+    /// Declared explicitly, as the move operations suppress the
+    /// implicit one, which would be chosen for a const argument
+    Tens& operator=(const Tens& oth)  ///< Tensor to copy
+    {
+      assign(*this,oth);
       
-//       printf("Creating a Tens of type %s moving\n",Tk::name());
+      return
+	*this;
+    }
+    
+    /// Move assignment, taking the storage and dropping the previous one
+    ///
+    /// Only provided for l-values, so that assigning to a temporary
+    /// view, such as a merged components one, still copies the
+    /// content through the \c SmET assignment
+    Tens& operator=(Tens&& oth) &
+    {
+      v=
+	std::move(oth.v);
       
-// #ifdef DEBUG_TENS
-//       using namespace std;
-//       cout<<"Tens move constructor!"<<endl;
-// #endif
-//     }
+      return
+	*this;
+    }
+    
+    /// Returns a deep copy, with newly allocated storage
+    ///
+    /// The content is copied in parallel by the thread pool
+    Tens clone()
+      const
+    {
+      return
+	Tens(v.clone());
+    }
     
     /// Destructor
     ~Tens()
@@ -124,18 +174,8 @@ namespace SUNphi
       cout<<"TensClass destroy: "<<this<<endl;
 #endif
       
-      if(freeAtDestroy)
-	{
 #ifdef DEBUG_TENS
- 	  printf("Destroying a Tens of type %s deallocating\n",Tk::name());
-#endif
-	  delete v;
-	}
-#ifdef DEBUG_TENS
-      else
-	{
-	  printf("Destroying a Tens of type %s NOT deallocating\n",Tk::name());
-	}
+      printf("Destroying a Tens of type %s, buffer shared by %d\n",Tk::name(),v.nBufferRefs());
 #endif
     }
     
@@ -145,26 +185,37 @@ namespace SUNphi
     PROVIDE_GET_MERGED_COMPS_VIEW(/*! Create a reference to the same storage with appropriate DynSizes */,
 				  /* Get a component-merged reference to the storage */
 				  auto vMerged=
-				    v->template mergedComps<Is>();
+				    v.template mergedComps<Is>();
 				  /* Returned TensKind */
 				  using MergedTk=
-				    typename Unqualified<decltype(*vMerged)>::Tk;
+				    typename decltype(vMerged)::Tk;
 				  /* Returned type */
 				  using TOut=
-				    Tens<MergedTk,Fund>;
+				    Tens<MergedTk,Fund,Idx,decltype(vMerged)::isView>;
 				  
-				  return TOut(vMerged));
+				  return TOut(std::move(vMerged)));
+    
+    /// Returns a view on the elements whose outermost component lies in the range [beg,end)
+    ///
+    /// The outermost component must be dynamic
+    Tens<Tk,Fund,Idx,Stor::View::isView> getOuterRangeView(const Idx& beg,  ///< Beginning of the range
+							    const Idx& end)  ///< End of the range
+      const
+    {
+      return
+	Tens<Tk,Fund,Idx,Stor::View::isView>(v.outerRangeView(beg,end));
+    }
     
     /// Returns a constant reference to v
-    const TensStor<Tk,Fund>& getStor() const
+    const Stor& getStor() const
     {
-      return *v;
+      return v;
     }
     
     /// Returns a non-constant reference to v
-    TensStor<Tk,Fund>& getStor()
+    Stor& getStor()
     {
-      return *v;
+      return v;
     }
     
     /// Enable or not printing the components
@@ -186,7 +237,7 @@ namespace SUNphi
 	((runLog()<<"Components: "<<&v) * ... *comps);			\
 									\
       return								\
-	v->eval(forw<const Comps>(comps)...);				\
+	v.eval(forw<const Comps>(comps)...);				\
     }
     
     PROVIDE_EVALUATOR(NON_CONST_QUALIF);
@@ -194,9 +245,50 @@ namespace SUNphi
     
 #undef PROVIDE_EVALUATOR
     
+    CAN_EVAL_SIMD_ATTRIBUTE(/*! The storage is accessed directly */,true);
+    
+    /// Evaluate a pack of consecutive elements along component VC
+    ///
+    /// If the tensor does not contain VC, the element is broadcast
+    template <typename VC,                                // Component to vectorize
+	      SIMDBackend B,                              // SIMD backend
+	      class...Comps,                              // Component types
+	      class=ConstrainAreIntegrals<Comps...>,      // Force the components to be integer-like
+	      class=ConstrainNTypes<Tk::nTypes,Comps...>> // Constrain the component to be in the same number of Tk
+    SIMDPack<Fund,B> evalSIMD(const Comps&...comps)  ///< Components of the first element
+      const
+    {
+      if constexpr(tupleHasType<VC,typename Tk::types>)
+	return
+	  v.template loadSIMD<VC,B>(comps...);
+      else
+	return
+	  SIMDPack<Fund,B>::broadcast(v.eval(comps...));
+    }
+    
+    /// Stores a pack into consecutive elements along component VC
+    template <typename VC,                                // Component to vectorize
+	      SIMDBackend B,                              // SIMD backend
+	      class...Comps,                              // Component types
+	      class=ConstrainAreIntegrals<Comps...>,      // Force the components to be integer-like
+	      class=ConstrainNTypes<Tk::nTypes,Comps...>> // Constrain the component to be in the same number of Tk
+    void storeSIMD(const SIMDPack<Fund,B>& pack,  ///< Pack to store
+		   const Comps&...comps)          ///< Components of the first element
+    {
+      v.template storeSIMD<VC,B>(pack,comps...);
+    }
+    
     PROVIDE_SMET_ASSIGNEMENT_OPERATOR(Tens);
   };
   
+  /// Deduce the type of a tensor viewing a storage
+  template <typename TK,     // List of tensor components
+	    typename FUND,   // Fundamental type
+	    typename IDX,    // Type used to index
+	    bool IS_VIEW>    // Mark whether the storage is a view
+  Tens(TensStor<TK,FUND,IDX,IS_VIEW>*)
+    -> Tens<TK,FUND,IDX,TensStor<TK,FUND,IDX,IS_VIEW>::View::isView>;
+  
   // Check that a test \c Tens is a \c NnarySmET
   STATIC_ASSERT_IS_SMET(Tens<TensKind<TensComp<double,1>>,double>);
   
@@ -106,6 +106,9 @@ namespace SUNphi
   /* Makes the Row and Column TYPE component twinned */			\
   DECLARE_TENS_COMPS_ARE_TWIN(Rw ## TYPE,Cn ## TYPE);			\
 									\
+  /* Marks the Column TYPE component as the one to be contracted */	\
+  DECLARE_TENS_COMP_IS_CN(Cn ## TYPE);					\
+									\
   /* Declares a row or column (aliasing) binder for type TYPE */	\
   DEFINE_NAMED_RW_OR_COL_BINDER(TYPE,BINDER);				\
 									\
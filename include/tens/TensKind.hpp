@@ -12,6 +12,7 @@
 #endif
 
 #include <array>
+#include <cstdint>
 
 
 #include <ints/IntSeqInsert.hpp>
@@ -25,15 +26,6 @@
 
 namespace SUNphi
 {
-  /// Dynamic sizes of a Tens
-  ///
-  /// \todo the array must be replaced with a tuple, whose types
-  /// must be deduced when instatiating the struct, such that int or
-  /// long int or whatever is appropriately used!
-  template <int N>
-  using DynSizes=
-    std::array<int,N>;
-  
   /// Defines the BaseTensKind type traits
   DEFINE_BASE_TYPE(TensKind);
   
@@ -43,14 +35,19 @@ namespace SUNphi
   class TensKind;
   /// \endcond
   
-  /// Dynamic sizes of a Tens
+  /// Default type used to index the elements of a Tens
   ///
-  /// \todo the array must be replaced with a tuple, whose types
-  /// must be deduced when instatiating the struct, such that int or
-  /// long int or whatever is appropriately used!
-  template <int N>
+  /// A 64 bit type is needed for tensors exceeding 2^31 elements,
+  /// such as fields on large lattices. A 32 bit type can be chosen
+  /// for small local volumes, where it is faster.
+  using TensIdx=
+    int64_t;
+  
+  /// Dynamic sizes of a Tens
+  template <int N,                // Number of dynamic components
+	    typename Idx=TensIdx> // Type used to index
   using DynSizes=
-    std::array<int,N>;
+    std::array<Idx,N>;
   
   // Provide a checker for compSize presence
   DEFINE_HAS_MEMBER(compSize);
@@ -5,16 +5,45 @@
 ///
 /// \brief Header file for the definition of a storage space for a tensor
 
+#include <ios/MappedFile.hpp>
 #include <metaprogramming/SFINAE.hpp>
 #include <metaprogramming/SwallowSemicolon.hpp>
 #include <system/Memory.hpp>
-#include <tens/Indexer.hpp>
+#include <ints/Ranges.hpp>
+#include <system/SIMD.hpp>
+#include <tens/SharedBuffer.hpp>
 #include <tens/TensKind.hpp>
 
+#include <algorithm>
 #include <cstdio>
+#include <functional>
 
 namespace SUNphi
 {
+  /// Maximal size in bytes of a fully static storage kept inside the object
+  [[ maybe_unused ]]
+  constexpr int MAX_INLINE_TENS_STOR_SIZE=
+    512;
+  
+  /// Buffer kept inside a tensor storage
+  ///
+  /// Used only if \c IsUsed is true, otherwise the buffer is empty
+  template <typename T,   // Type of the data
+	    int N,        // Number of elements
+	    bool IsUsed>  // Mark whether the buffer is used
+  struct TensStorInlineBuffer
+  {
+    /// Data
+    alignas(ALIGNMENT) T data[N];
+  };
+  
+  /// Empty buffer, when not used
+  template <typename T,   // Type of the data
+	    int N>        // Number of elements
+  struct TensStorInlineBuffer<T,N,false>
+  {
+  };
+  
   /// Tensor Storage holding the resources for a tensor
   ///
   /// The tensor storage allocates and deallocates the memory location
@@ -22,10 +51,29 @@ namespace SUNphi
   /// of memory allocated. Facilities to reallocate the memory are
   /// provided.
   ///
-  /// \todo many things, including considering a static storage if
-  /// size is small and statically known
+  /// If all components are static and the size does not exceed \c
+  /// MAX_INLINE_TENS_STOR_SIZE, the data is kept inside the object,
+  /// so that small tensors such as SU(3) matrices cost no allocation.
+  ///
+  /// Copies are always deep, whatever the place where the data is
+  /// kept. Views sharing the data are only obtained explicitly,
+  /// through \c view, \c outerRangeView and \c mergedComps, and
+  /// share the ownership of the buffer, which is released when the
+  /// last of them is destroyed. Views of data kept inside the object do not own it,
+  /// and must not outlive the storage: they are of a different type,
+  /// marked by \c IS_VIEW, which does not contain the buffer.
+  ///
+  /// The elements are indexed with type \c IDX, 64 bit by default. A
+  /// 32 bit type can be chosen for small local volumes.
+  ///
+  /// The stride of each component is precomputed at construction, or
+  /// folded at compile time if all the following components are
+  /// static, so that an element is located through a dot product of
+  /// the components with the strides.
   template <class TK,
-	    class T>
+	    class T,
+	    class IDX=TensIdx,
+	    bool IS_VIEW=false>
   class TensStor :
     public ConstrainIsTensKind<TK> // Check that TK is a TensKind
   {
@@ -36,9 +84,60 @@ namespace SUNphi
     /// Internal storage
     T* v;
     
-    /// Store whether this has been created or is a reference
-    bool created=
-      false;
+    /// Ownership of the buffer, shared with copies and views
+    SharedBuffer buffer;
+    
+  public:
+    
+    /// Store whether the storage is a view on the data kept inside another one
+    static constexpr bool isView=
+      IS_VIEW;
+    
+    /// Store whether the data is kept inside the object
+    static constexpr bool hasInlineStorage=
+      (not IS_VIEW) and TK::isFullyStatic and sizeof(T)*TK::maxStaticIdx<=MAX_INLINE_TENS_STOR_SIZE;
+    
+    /// Type of the views on the data
+    ///
+    /// Only the storages keeping the data inside the object are viewed
+    /// through a different type
+    using View=
+      TensStor<TK,T,IDX,IS_VIEW or hasInlineStorage>;
+    
+  private:
+    
+    /// Storage inside the object, used if the tensor is small and fully static
+    TensStorInlineBuffer<T,TK::maxStaticIdx,hasInlineStorage> inlineBuffer;
+    
+    /// Check if the data is kept inside the object
+    bool isUsingInlineBuffer()
+      const
+    {
+      if constexpr(hasInlineStorage)
+	return
+	  v==inlineBuffer.data;
+      else
+	return
+	  false;
+    }
+    
+    /// Takes the buffer of a storage being moved, copying the data if kept inside it
+    void takeBufferOf(const TensStor& oth) ///< Storage whose buffer is taken
+    {
+      if constexpr(hasInlineStorage)
+	if(oth.isUsingInlineBuffer())
+	  {
+	    std::copy(oth.v,oth.v+totSize,inlineBuffer.data);
+	    
+	    v=
+	      inlineBuffer.data;
+	    
+	    return;
+	  }
+      
+      v=
+	oth.v;
+    }
     
   public:
     
@@ -46,22 +145,112 @@ namespace SUNphi
     using Tk=
       TK;
     
+    /// Type used to index
+    using Idx=
+      IDX;
+    
     /// Debug access to internal storage
     T* &_v=
       v;
     
     /// Debug store size
-    int totSize;
+    Idx totSize;
+    
+    /// Stride of the component in position I, if known at compile time
+    ///
+    /// Internal implementation
+    template <int I>  // Position of the component
+    static constexpr int _staticCompStrideOfPos()
+    {
+      if constexpr(I+1>=TK::nTypes)
+	return
+	  1;
+      else
+	{
+	  /// Size of the next component
+	  constexpr int nextSize=
+	    TupleElementType<I+1,type>::size;
+	  
+	  /// Stride of the next component
+	  constexpr int nextStride=
+	    _staticCompStrideOfPos<I+1>();
+	  
+	  if constexpr(nextSize==DYNAMIC or nextStride==DYNAMIC)
+	    return
+	      DYNAMIC;
+	  else
+	    return
+	      nextSize*nextStride;
+	}
+    }
+    
+    /// Stride of the component in position I, if known at compile time
+    ///
+    /// The stride is the product of the sizes of the following
+    /// components, and is \c DYNAMIC if any of them is dynamic
+    template <int I>  // Position of the component
+    static constexpr int staticCompStrideOfPos=
+      _staticCompStrideOfPos<I>();
+    
+    /// Returns the stride of the component in position I
+    template <int I>  // Position of the component
+    Idx compStrideOfPos()
+      const
+    {
+      if constexpr(staticCompStrideOfPos<I>!=DYNAMIC)
+	return
+	  staticCompStrideOfPos<I>;
+      else
+	return
+	  strides[I];
+    }
+    
+    /// Returns the stride of a given component
+    template <typename TC>  // Component
+    Idx compStride()
+      const
+    {
+      return
+	compStrideOfPos<posOfType<TC,type>>();
+    }
+    
+    /// Returns the offset of an element, given the components
+    ///
+    /// The offset is the dot product of the components with the strides
+    template <int...I,        // Position of the components
+	      class...Args>   // Type of the components
+    Idx offset(const IntSeq<I...>&,
+	       const Args&...args)  ///< Components
+      const
+    {
+      static_assert(sizeof...(Args)==TK::nTypes,"Number of TensComp does not match number of passed components");
+      
+      return
+	(Idx{0}+...+(compStrideOfPos<I>()*args));
+    }
+    
+    /// Moves a pointer to an element by n elements along a given component
+    ///
+    /// No other work than adding the stride is done, so that loops
+    /// over a component become pointer increments
+    template <typename TC>  // Component
+    void advance(T*& ptr,        ///< Pointer to move
+		 const Idx n=1)  ///< Number of elements to move by
+      const
+    {
+      ptr+=
+	n*compStride<TC>();
+    }
     
     /// Defines a const or non-const evaluator
 #define PROVIDE_EVAL(QUALIFIER)						\
     /*! Returns a QUALIFIER reference to a TensStor given a set of components            */ \
     template <class...Args,                          /* Arguments type                   */ \
-	      class=ConstrainAreSame<int,Args...>>   /* Constrain all args to be integer */ \
+	      class=ConstrainAreIntegrals<Args...>>  /* Constrain all args to be integer */ \
     QUALIFIER T& eval(const Args&...args) QUALIFIER  /*!< Components to extract          */ \
     {									\
-      const int id=index<TK>(dynSizes,forw<const Args>(args)...);	\
-      /* printf("Index: %d\n",id);*/ /*debug*/				\
+      const Idx id=offset(IntsUpTo<TK::nTypes>{},args...);		\
+      /* printf("Index: %lld\n",(long long)id);*/ /*debug*/		\
       									\
       return v[id];							\
     }
@@ -72,13 +261,70 @@ namespace SUNphi
     // Undefine the macro
 #undef PROVIDE_EVAL
     
+    /// Loads a pack of consecutive elements along component TC
+    ///
+    /// The components passed point to the first element of the pack.
+    /// If TC is the innermost component the elements are contiguous,
+    /// otherwise they are gathered through the stride
+    template <typename TC,                           // Component along which to load
+	      SIMDBackend B,                         // SIMD backend
+	      class...Args,                          // Arguments type
+	      class=ConstrainAreIntegrals<Args...>>  // Constrain all args to be integer
+    SIMDPack<T,B> loadSIMD(const Args&...args)  ///< Components of the first element
+      const
+    {
+      /// First element
+      const T* ptr=
+	&v[offset(IntsUpTo<TK::nTypes>{},args...)];
+      
+      /// Stride of the component
+      const Idx stride=
+	compStride<TC>();
+      
+      if(stride==1)
+	return
+	  SIMDPack<T,B>::load(ptr);
+      else
+	return
+	  SIMDPack<T,B>::gather(ptr,stride);
+    }
+    
+    /// Stores a pack into consecutive elements along component TC
+    ///
+    /// See \c loadSIMD for the layout
+    template <typename TC,                           // Component along which to store
+	      SIMDBackend B,                         // SIMD backend
+	      class...Args,                          // Arguments type
+	      class=ConstrainAreIntegrals<Args...>>  // Constrain all args to be integer
+    void storeSIMD(const SIMDPack<T,B>& pack,  ///< Pack to store
+		   const Args&...args)         ///< Components of the first element
+    {
+      /// First element
+      T* ptr=
+	&v[offset(IntsUpTo<TK::nTypes>{},args...)];
+      
+      /// Stride of the component
+      const Idx stride=
+	compStride<TC>();
+      
+      if(stride==1)
+	pack.store(ptr);
+      else
+	pack.scatter(ptr,stride);
+    }
+    
     /// Dynamic sizes
-    DynSizes<TK::nDynamic> dynSizes;
+    DynSizes<TK::nDynamic,Idx> dynSizes;
+    
+    /// Stride of each component
+    ///
+    /// Only the strides not known at compile time are used
+    std::array<Idx,TK::nTypes> strides;
     
     /// Returns the size of a given component in the case it is Dynamic
     template <typename TC,
 	      SFINAE_ON_TEMPLATE_ARG(isDynamic<TC>)>
-    constexpr int compSize() const
+    constexpr Idx compSize() const
     {
       return dynSizes[TK::template dynCompPos<TC>];
     }
@@ -86,7 +332,7 @@ namespace SUNphi
     /// Returns the size of a given component in the case it is not Dynamic
     template <typename TC,
 	      SFINAE_ON_TEMPLATE_ARG(not isDynamic<TC>)>
-    int compSize() const
+    Idx compSize() const
     {
       return TC::size;
     }
@@ -94,7 +340,7 @@ namespace SUNphi
     /// Returns the total size of the range [Beg, End)
     template <int Beg, // Begin of the range
 	      int End> // End of the range
-    int compsRangeSize() const
+    Idx compsRangeSize() const
     {
       // If empty range, returns 0
       if constexpr(Beg>=End)
@@ -104,7 +350,7 @@ namespace SUNphi
 	  // TensComp number Beg
 	  using Tc=TupleElementType<Beg,typename TK::types>;
 	  // Compute this comp size
-	  int tmp=compSize<Tc>();
+	  Idx tmp=compSize<Tc>();
 	  // If more components present, nest
 	  if constexpr(Beg+1<End)
 	    return tmp*compsRangeSize<Beg+1,End>();
@@ -122,7 +368,7 @@ namespace SUNphi
     {
       using Is=IntSeq<Delims...>;
       
-      DynSizes<sizeof...(DynComps)> sizes=
+      DynSizes<sizeof...(DynComps),Idx> sizes=
 	{{compsRangeSize<
 	  Is::template element<DynComps>(),
 	  Is::template element<DynComps+1>()>()...}};
@@ -140,36 +386,108 @@ namespace SUNphi
       
       /// Returned type
       using TOut=
-	TensStor<MergedTk,T>;
+	TensStor<MergedTk,T,Idx,View::isView>;
       
       /// Position of the merged dynamical components
       using MergedDynCompPos=
 	typename MergedTk::DynCompsPos;
       
       /// Dynamic sizes after merge
-      const DynSizes<MergedTk::nDynamic> mergedDynSizes=
+      const DynSizes<MergedTk::nDynamic,Idx> mergedDynSizes=
 	compsRangeGroupsSize(Is{},MergedDynCompPos{});
       
-      return new TOut(mergedDynSizes,v);
+      return
+	TOut(mergedDynSizes,v,buffer);
     }
     
-    /// Allocator
-    void alloc()
+    /// Returns a view on the same data, sharing the buffer
+    View view()
+      const
+    {
+      return
+	View(dynSizes,v,buffer);
+    }
+    
+    /// Returns a view on the elements whose outermost component lies in the range [beg,end)
+    ///
+    /// The outermost component must be dynamic, and the view shares the buffer
+    View outerRangeView(const Idx& beg,  ///< Beginning of the range
+			const Idx& end)  ///< End of the range
+      const
     {
-      // Mark down that we are creating
-      created=
-	true;
+      static_assert(TK::DynCompsPos::template has<0>,"Only a dynamic outermost component can be restricted");
       
-      // Compute the size
+      /// Dynamic sizes of the view
+      DynSizes<TK::nDynamic,Idx> rangeDynSizes=
+	dynSizes;
+      
+      rangeDynSizes[0]=
+	end-beg;
+      
+      return
+	View(rangeDynSizes,v+beg*strides[0],buffer);
+    }
+    
+    /// Tag of the allocations, named after the tensor kind
+    static Memory::Tag* memoryTag()
+    {
+      /// Tag, looked up once
+      static Memory::Tag* const tag=
+	memory.getTag(TK::name());
+      
+      return
+	tag;
+    }
+    
+    /// Computes the strides, starting from the component in position I
+    template <int I=TK::nTypes-1>  // Position of the component
+    void computeStrides(const Idx stride=1)  ///< Stride of the component
+    {
+      if constexpr(I>=0)
+	{
+	  strides[I]=
+	    stride;
+	  
+	  computeStrides<I-1>(stride*compSize<TupleElementType<I,type>>());
+	}
+    }
+    
+    /// Computes the total size and the strides
+    void computeTotSize()
+    {
       totSize=
 	TK::maxStaticIdx;
       for(const auto &i : dynSizes)
 	totSize*=
 	  i;
       
-      // Allocate
-      v=
-	memory.provideAligned<T>(totSize,ALIGNMENT);
+      computeStrides();
+    }
+    
+    /// Allocator
+    void alloc()
+    {
+      // Compute the size
+      computeTotSize();
+      
+      if constexpr(hasInlineStorage)
+	v=
+	  inlineBuffer.data;
+      else
+	{
+	  // Allocate
+	  v=
+	    memory.provideAligned<T>(totSize,ALIGNMENT,memoryTag());
+	  
+	  // Place each chunk on the NUMA node of the thread looping on it
+	  memory.bindToThreadsNumaNodes(v,totSize);
+	  
+	  // Fault the pages in from the threads which will use them
+	  memory.firstTouchInParallel(v,totSize);
+	  
+	  buffer=
+	    SharedBuffer::ofMemory(v);
+	}
       
 #ifdef DEBUG_STOR
       runLog()<<"TensStor constructor: "<<v<<", "<<__PRETTY_FUNCTION__;
@@ -181,7 +499,7 @@ namespace SUNphi
 	      typename=EnableIf<areIntegrals<Unqualified<DynSizes>...>>,      // Constrain to be integers
 	      class=ConstrainNTypes<TK::nDynamic,DynSizes...>>                // Constrain to be in the correct number
     explicit TensStor(DynSizes&&...extDynSizes) :
-      dynSizes({{extDynSizes...}})          // Store the sizes
+      dynSizes({{static_cast<Idx>(extDynSizes)...}})          // Store the sizes
     {
       // Constrain the arguments to be all integer-like
       STATIC_ASSERT_ARE_INTEGRALS(Unqualified<DynSizes>...);
@@ -191,36 +509,159 @@ namespace SUNphi
     }
     
     /// Constructor taking dynSizes and pointer (test)
-    explicit TensStor(const DynSizes<TK::nDynamic>& dynSizes,
+    ///
+    /// The buffer is not owned, and must outlive the storage
+    explicit TensStor(const DynSizes<TK::nDynamic,Idx>& dynSizes,
 		      T* v) :
       v(v),                       // Copy the ref
       dynSizes(dynSizes)          // Store the sizes
     {
+      computeTotSize();
     }
     
-    /// Copy constructor (test)
+    /// Constructor taking dynSizes and pointer, sharing the ownership of the buffer
+    explicit TensStor(const DynSizes<TK::nDynamic,Idx>& dynSizes,  ///< Dynamic sizes
+		      T* v,                                        ///< Beginning of the data
+		      const SharedBuffer& buffer) :                ///< Buffer containing the data
+      v(v),
+      buffer(buffer),
+      dynSizes(dynSizes)
+    {
+      computeTotSize();
+    }
+    
+    /// Constructor mapping a file as storage
+    ///
+    /// The data is not copied, and is read lazily from the file when
+    /// accessed. In \c READ_ONLY mode the storage must not be written,
+    /// in \c COPY_ON_WRITE mode the changes are not propagated to the
+    /// file. The file is unmapped at destruction. Example:
     ///
-    /// \todo improve memcpy, this could be parallelized in many ways,
-    /// we have to implement memory manager soon
-    explicit TensStor(const TensStor& oth) :
+    /// \code
+    /// TensStor<TensKind<Spacetime,Dir,RwCol,CnCol,Compl>,double> stor(DynSizes<1>{{vol}},"conf.bin");
+    /// stor.prefetch();
+    /// Tens<TensKind<Spacetime,Dir,RwCol,CnCol,Compl>,double> conf(&stor);
+    /// \endcode
+    explicit TensStor(const DynSizes<TK::nDynamic,Idx>& dynSizes,           ///< Dynamic sizes
+		      const std::filesystem::path& path,                    ///< Path of the file
+		      const FileMapping& mode=FileMapping::READ_ONLY,       ///< Mode used to map
+		      const size_t offset=0) :                              ///< Offset of the data inside the file
+      TensStor(dynSizes,nullptr)
+    {
+      /// Mapped file
+      MappedFile mappedFile(path,sizeof(T)*totSize,mode,offset);
+      
+      v=
+	static_cast<T*>(mappedFile.getData());
+      
+      buffer=
+	SharedBuffer::ofMappedFile(std::move(mappedFile));
+    }
+    
+    /// Asks the kernel to read in advance the mapped file, if any
+    void prefetch()
+      const
+    {
+      buffer.prefetch();
+    }
+    
+    /// Copy constructor, copying the data into a new buffer
+    ///
+    /// The copy is split among the threads with the same partition
+    /// used for the first touch
+    TensStor(const TensStor& oth) :
       dynSizes(oth.dynSizes)
     {
       alloc();
       
-      for(int i=0;i<totSize;i++)
-	v[i]=oth.v[i];
+      memory.copyInParallel(v,oth.v,totSize);
+    }
+    
+    /// Move constructor, taking the buffer
+    TensStor(TensStor&& oth) :
+      buffer(std::move(oth.buffer)),
+      totSize(oth.totSize),
+      dynSizes(oth.dynSizes),
+      strides(oth.strides)
+    {
+      takeBufferOf(oth);
+      
+      oth.v=
+	nullptr;
+    }
+    
+    /// Move assignment, taking the buffer and dropping the previous one
+    TensStor& operator=(TensStor&& oth)
+    {
+      if(this!=&oth)
+	{
+	  buffer=
+	    std::move(oth.buffer);
+	  
+	  totSize=
+	    oth.totSize;
+	  
+	  dynSizes=
+	    oth.dynSizes;
+	  
+	  strides=
+	    oth.strides;
+	  
+	  takeBufferOf(oth);
+	  
+	  oth.v=
+	    nullptr;
+	}
+      
+      return
+	*this;
+    }
+    
+    /// Returns a deep copy, with a newly allocated buffer
+    TensStor clone()
+      const
+    {
+      return
+	TensStor(*this);
+    }
+    
+    /// Check whether the data overlaps with the range [beg,end)
+    bool overlapsWith(const void* beg,  ///< Beginning of the range
+		      const void* end)  ///< End of the range
+      const
+    {
+      /// Total order of the pointers
+      const std::less<const void*> less;
+      
+      return
+	less(v,end) and less(beg,v+totSize);
+    }
+    
+    /// Check whether the data overlaps with the one of another storage
+    template <typename S>  // Type of the other storage
+    bool overlapsWith(const S& oth)  ///< Other storage
+      const
+    {
+      return
+	overlapsWith(oth._v,oth._v+oth.totSize);
+    }
+    
+    /// Number of storages sharing the buffer, zero if not owned
+    int nBufferRefs()
+      const
+    {
+      return
+	buffer.nRefs();
     }
     
     /// Destructor
+    ///
+    /// The buffer is released by the last storage referring to it
     ~TensStor()
     {
 #ifdef DEBUG_STOR
       runLog()<<"TensStor destructor: "<<v<<", "<<__PRETTY_FUNCTION__;
 #endif
-      
-      // Free
-      if(created)
-	memory.release(v);
     }
   };
   
@@ -27,6 +27,25 @@ namespace SUNphi
   constexpr inline bool hasTwin=
     false;
   
+  /// Determine if the TensComp is the column one of a row/column twin pair
+  ///
+  /// Default for a generic TensComp: false
+  template <class T,                         // Type to declare not column
+	    class=ConstrainIsTensComp<T>>    // Constrain the T to be a TensComp
+  [[ maybe_unused ]]
+  constexpr inline bool isCnTensComp=
+    false;
+  
+  /// Declare that the TensComp T is the column one of a row/column twin pair
+#define DECLARE_TENS_COMP_IS_CN(T)		\
+  						\
+  /*! Declare that T is a column component */	\
+  template <>					\
+  constexpr inline bool isCnTensComp<T> =	\
+    true;					\
+						\
+  MAYBE_UNUSED(isCnTensComp<T>)
+  
   /// Specify the twin component of a given TensComp
   ///
   /// Internal implementation for generic case, returning the input
@@ -0,0 +1,316 @@
+#ifndef _AFFINITY_HPP
+#define _AFFINITY_HPP
+
+/// \file Affinity.hpp
+///
+/// \brief Pinning of threads to the cores, and NUMA topology
+///
+/// The pinning policy of the thread pool is chosen through the
+/// environment:
+///
+/// - \c SUNPHI_THREAD_PINNING can be \c none (default), \c compact or
+///   \c scatter;
+/// - \c SUNPHI_THREAD_CORES is an explicit list of cores in the kernel
+///   format, e.g. "0-3,8,10-11", and takes precedence over the former.
+///
+/// The NUMA node of each core is read from \c /sys, so that no
+/// external library is needed.
+
+#ifdef HAVE_CONFIG_H
+ #include "config.hpp"
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <sched.h>
+#include <string>
+
+#include <containers/Vector.hpp>
+#include <debug/MinimalCrash.hpp>
+#include <threads/Thread.hpp>
+
+namespace SUNphi
+{
+  /// Policy used to pin the threads to the cores
+  enum class ThreadPinning{NONE,     ///< Threads are free to migrate
+			   COMPACT,  ///< Consecutive threads on consecutive cores, filling a NUMA node before the next
+			   SCATTER,  ///< Consecutive threads on different NUMA nodes, round-robin
+			   LIST};    ///< Explicit list of cores
+  
+  /// Name of the environment variable selecting the pinning policy
+  [[ maybe_unused ]]
+  constexpr char THREAD_PINNING_ENV_VAR[]=
+    "SUNPHI_THREAD_PINNING";
+  
+  /// Name of the environment variable listing the cores explicitly
+  [[ maybe_unused ]]
+  constexpr char THREAD_CORES_ENV_VAR[]=
+    "SUNPHI_THREAD_CORES";
+  
+  /// Returns a string describing the pinning policy
+  inline const char* threadPinningName(const ThreadPinning& pinning) ///< Policy to describe
+  {
+    switch(pinning)
+      {
+      case ThreadPinning::NONE:
+	return
+	  "none";
+      case ThreadPinning::COMPACT:
+	return
+	  "compact";
+      case ThreadPinning::SCATTER:
+	return
+	  "scatter";
+      case ThreadPinning::LIST:
+	return
+	  "list";
+      }
+    
+    return
+      "";
+  }
+  
+  /// Parses a list of cores in the kernel format, such as "0-3,8,10-11"
+  ///
+  /// Cores which cannot be stored in a \c cpu_set_t are rejected
+  inline Vector<int> parseCoreList(const char* str) ///< String to parse
+  {
+    /// Result
+    Vector<int> res;
+    
+    while(*str!='\0')
+      {
+	/// End of the parsed number
+	char* endPtr;
+	
+	/// First core of the range
+	const int first=
+	  strtol(str,&endPtr,10);
+	
+	if(endPtr==str)
+	  MINIMAL_CRASH("Unable to parse the core list at %s",str);
+	
+	/// Last core of the range
+	int last=
+	  first;
+	
+	str=
+	  endPtr;
+	
+	if(*str=='-')
+	  {
+	    last=
+	      strtol(str+1,&endPtr,10);
+	    
+	    if(endPtr==str+1)
+	      MINIMAL_CRASH("Unable to parse the core list at %s",str);
+	    
+	    str=
+	      endPtr;
+	  }
+	
+	if(first<0 or last>=CPU_SETSIZE)
+	  MINIMAL_CRASH("Core range %d-%d exceeds the allowed range 0-%d",first,last,CPU_SETSIZE-1);
+	
+	for(int core=first;core<=last;core++)
+	  res.push_back(core);
+	
+	// Skips separators and spaces, as the newline of files in /sys
+	while(*str==',' or *str==' ' or *str=='\n')
+	  str++;
+      }
+    
+    return
+      res;
+  }
+  
+  /// Cores on which the process is allowed to run
+  inline Vector<int> getAvailableCores()
+  {
+    /// Mask of the process
+    cpu_set_t mask;
+    
+    if(sched_getaffinity(0,sizeof(cpu_set_t),&mask)!=0)
+      MINIMAL_CRASH_STDLIBERR("getting the affinity of the process");
+    
+    /// Result
+    Vector<int> res;
+    
+    for(int core=0;core<CPU_SETSIZE;core++)
+      if(CPU_ISSET(core,&mask))
+	res.push_back(core);
+    
+    return
+      res;
+  }
+  
+  /// NUMA node of each core, indexed by the core
+  ///
+  /// Cores not listed in \c /sys are assigned to node 0
+  inline Vector<int> getNumaNodeOfCores()
+  {
+    /// Result
+    Vector<int> res(CPU_SETSIZE,0);
+    
+    /// Path where the nodes are listed
+    const std::filesystem::path nodesPath=
+      "/sys/devices/system/node";
+    
+    /// Error returned by the filesystem
+    std::error_code err;
+    
+    for(const auto& entry : std::filesystem::directory_iterator(nodesPath,err))
+      {
+	/// Name of the entry
+	const std::string name=
+	  entry.path().filename();
+	
+	if(name.compare(0,4,"node")==0 and name.size()>4 and isdigit(name[4]))
+	  if(FILE* fin=fopen((entry.path()/"cpulist").c_str(),"r"))
+	    {
+	      /// Content of the list
+	      char list[1024]{};
+	      
+	      if(fgets(list,sizeof(list),fin)!=nullptr)
+		for(const int& core : parseCoreList(list))
+		  res[core]=
+		    atoi(name.c_str()+4);
+	      
+	      fclose(fin);
+	    }
+      }
+    
+    return
+      res;
+  }
+  
+  /// Reads the pinning policy from the environment
+  inline ThreadPinning getThreadPinningFromEnv()
+  {
+    if(getenv(THREAD_CORES_ENV_VAR)!=nullptr)
+      return
+	ThreadPinning::LIST;
+    
+    /// Policy written in the environment
+    const char* policy=
+      getenv(THREAD_PINNING_ENV_VAR);
+    
+    if(policy==nullptr or strcmp(policy,"none")==0)
+      return
+	ThreadPinning::NONE;
+    
+    if(strcmp(policy,"compact")==0)
+      return
+	ThreadPinning::COMPACT;
+    
+    if(strcmp(policy,"scatter")==0)
+      return
+	ThreadPinning::SCATTER;
+    
+    MINIMAL_CRASH("Unknown pinning policy %s, use none, compact or scatter",policy);
+    
+    return
+      ThreadPinning::NONE;
+  }
+  
+  /// Computes the core to which each thread must be pinned
+  ///
+  /// Returns -1 for all threads if the policy is \c NONE. If there
+  /// are more threads than cores, the cores are reused cyclically.
+  inline Vector<int> getThreadsCores(const ThreadPinning& pinning,   ///< Policy
+				     const int& nThreads)            ///< Number of threads
+  {
+    /// Result
+    Vector<int> res(nThreads,-1);
+    
+    if(pinning==ThreadPinning::NONE)
+      return
+	res;
+    
+    /// Cores to be used, in the order in which they are assigned
+    Vector<int> cores;
+    
+    if(pinning==ThreadPinning::LIST)
+      cores=
+	parseCoreList(getenv(THREAD_CORES_ENV_VAR));
+    else
+      {
+	/// NUMA node of each core
+	const Vector<int> numaNodeOfCore=
+	  getNumaNodeOfCores();
+	
+	cores=
+	  getAvailableCores();
+	
+	// Groups the cores by NUMA node
+	std::stable_sort(cores.begin(),cores.end(),[&numaNodeOfCore](const int& first,const int& second)
+						   {
+						     return
+						       numaNodeOfCore[first]<numaNodeOfCore[second];
+						   });
+	
+	if(pinning==ThreadPinning::SCATTER)
+	  {
+	    /// Cores of each NUMA node
+	    Vector<Vector<int>> coresOfNode;
+	    
+	    for(const int& core : cores)
+	      {
+		if(coresOfNode.size()==0 or numaNodeOfCore[coresOfNode.back().front()]!=numaNodeOfCore[core])
+		  coresOfNode.emplace_back();
+		
+		coresOfNode.back().push_back(core);
+	      }
+	    
+	    /// Maximal number of cores in a node
+	    int maxNCoresPerNode=
+	      0;
+	    
+	    for(const Vector<int>& nodeCores : coresOfNode)
+	      maxNCoresPerNode=
+		std::max(maxNCoresPerNode,(int)nodeCores.size());
+	    
+	    cores.clear();
+	    
+	    // Takes in turn one core per node
+	    for(int iCore=0;iCore<maxNCoresPerNode;iCore++)
+	      for(const Vector<int>& nodeCores : coresOfNode)
+		if(iCore<nodeCores.size())
+		  cores.push_back(nodeCores[iCore]);
+	  }
+      }
+    
+    if(cores.size()==0)
+      MINIMAL_CRASH("No core available to pin the threads");
+    
+    for(int threadId=0;threadId<nThreads;threadId++)
+      res[threadId]=
+	cores[threadId%cores.size()];
+    
+    return
+      res;
+  }
+  
+  /// Pins the calling thread to the given core
+  ///
+  /// Nothing is done if the core is negative
+  inline void pinCurrentThreadToCore(const int& core) ///< Core where to pin
+  {
+    if(core<0)
+      return;
+    
+    /// Mask containing only the core
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(core,&mask);
+    
+    if(pthread_setaffinity_np(pthread_self(),sizeof(cpu_set_t),&mask)!=0)
+      MINIMAL_CRASH_STDLIBERR("pinning the thread");
+  }
+}
+
+#endif
@@ -4,6 +4,14 @@
 /// \file Barrier.hpp
 ///
 /// \brief Define the threads barrier
+///
+/// Two implementations are provided. By default the barrier wraps \c
+/// pthread_barrier_t. If \c USE_FUTEX_BARRIER is defined at configure
+/// time (\c --enable-futex-barrier) a sense-reversing barrier is used
+/// instead: the waiting threads spin on the generation counter for a
+/// bounded number of iterations, and only then sleep on a futex. When
+/// the parallel regions are short, threads are released without going
+/// through the kernel.
 
 #ifdef HAVE_CONFIG_H
  #include "config.hpp"
@@ -11,12 +19,179 @@
 
 #include <cstring>
 
+#ifdef USE_FUTEX_BARRIER
+ #include <atomic>
+ #include <cerrno>
+ #include <climits>
+ #include <linux/futex.h>
+ #include <sys/syscall.h>
+ #include <unistd.h>
+#endif
+
 #include <debug/MinimalCrash.hpp>
 #include <threads/Thread.hpp>
 
 namespace SUNphi
 {
 #ifdef USE_THREADS
+#ifdef USE_FUTEX_BARRIER
+  
+  /// Sense-reversing barrier, spinning and then waiting on a futex
+  ///
+  /// Low level barrier not meant to be called explictly
+  ///
+  /// The sense is given by the generation counter, incremented by the
+  /// last thread reaching the barrier, so that no per-thread state is
+  /// needed. The other threads spin until the generation changes, and
+  /// after \c nSpinIterations sleep on the futex associated to it.
+  class Barrier
+  {
+    /// Default number of spinning iterations before sleeping
+    static constexpr int DEFAULT_N_SPIN_ITERATIONS=
+      1<<14;
+    
+    /// Number of threads synchronized by the barrier
+    int nThreads;
+    
+    /// Number of spinning iterations before sleeping on the futex
+    int nSpinIterations;
+    
+    /// Number of threads arrived in the current generation
+    alignas(CACHE_LINE_SIZE) std::atomic<int> nArrived{0};
+    
+    /// Generation of the barrier, incremented at each release
+    ///
+    /// Used as the futex word, so it must be a 32 bit integer
+    alignas(CACHE_LINE_SIZE) std::atomic<int> generation{0};
+    
+    /// Number of threads sleeping on the futex
+    std::atomic<int> nSleeping{0};
+    
+#ifdef DEBUG_MODE
+    
+    /// Value used to check the barrier
+    [[maybe_unused ]]
+    const char* currBarrName;
+    
+#endif
+    
+    /// Issues a futex operation on the generation counter
+    long futex(const int& op,   ///< Futex operation
+	       const int& val)  ///< Value passed to the operation
+    {
+      return
+	syscall(SYS_futex,reinterpret_cast<int*>(&generation),op,val,nullptr,nullptr,0);
+    }
+    
+    /// Hint to the processor that we are busy waiting
+    static void cpuRelax()
+    {
+#if defined(__x86_64__) or defined(__i386__)
+      __builtin_ia32_pause();
+#endif
+    }
+    
+    /// Waits that the generation differs from \c gen
+    void waitForRelease(const int& gen) ///< Generation at the arrival
+    {
+      for(int iSpin=0;iSpin<nSpinIterations;iSpin++)
+	if(generation.load(std::memory_order_acquire)!=gen)
+	  return;
+	else
+	  cpuRelax();
+      
+      nSleeping.fetch_add(1);
+      
+      // The kernel checks atomically that the generation is still
+      // gen before sleeping, so a release cannot be missed
+      while(generation.load(std::memory_order_acquire)==gen)
+	if(futex(FUTEX_WAIT_PRIVATE,gen)!=0 and errno!=EAGAIN and errno!=EINTR)
+	  MINIMAL_CRASH_STDLIBERR("while barrier was waiting on futex");
+      
+      nSleeping.fetch_sub(1);
+    }
+    
+    /// Raw synchronization, simply wait that all threads call this
+    void rawSync()
+    {
+      /// Generation at the arrival
+      const int gen=
+	generation.load(std::memory_order_acquire);
+      
+      if(nArrived.fetch_add(1,std::memory_order_acq_rel)==nThreads-1)
+	{
+	  // The counter is reset before the release, so no thread can
+	  // arrive at the next generation before
+	  nArrived.store(0,std::memory_order_relaxed);
+	  
+	  generation.fetch_add(1);
+	  
+	  if(nSleeping.load()>0 and futex(FUTEX_WAKE_PRIVATE,INT_MAX)<0)
+	    MINIMAL_CRASH_STDLIBERR("while barrier was waking up threads");
+	}
+      else
+	waitForRelease(gen);
+    }
+    
+    /// Number of spinning iterations for a given number of threads
+    ///
+    /// If more threads than cores are used, spinning would only steal
+    /// time to the threads still to come, so threads sleep immediately
+    static int computeNSpinIterations(const int& nThreads) ///< Number of threads
+    {
+      return
+	(nThreads<=(int)std::thread::hardware_concurrency())?DEFAULT_N_SPIN_ITERATIONS:0;
+    }
+    
+  public:
+    
+    /// Build the barrier for \c nThreads threads
+    Barrier(const int& nThreads) ///< Number of threads for which the barrier is defined
+      : nThreads(nThreads),
+	nSpinIterations(computeNSpinIterations(nThreads))
+    {
+    }
+    
+    /// Changes the number of threads, when no thread is waiting
+    void resize(const int& nNewThreads) ///< New number of threads
+    {
+      nThreads=
+	nNewThreads;
+      
+      nSpinIterations=
+	computeNSpinIterations(nThreads);
+    }
+    
+    /// Synchronize, without checking the name of the barrier
+    void sync()
+    {
+      rawSync();
+    }
+    
+    /// Synchronize checking the name of the barrier
+    void sync(const char* barrName, ///< Name of the barrier
+	      const int& threadId)  ///< Id of the thread used coming to check
+    {
+      rawSync();
+      
+#ifdef DEBUG_MODE
+      
+      if(threadId==masterThreadId)
+	currBarrName=
+	  barrName;
+      
+      rawSync();
+      
+      if(currBarrName!=barrName)
+	MINIMAL_CRASH("Thread id %d was expecting %s but encountered %s",threadId,currBarrName,barrName);
+      
+#endif
+      
+    }
+  };
+  
+#else
+  
   /// Wrapper for the pthread barrier functionality
   ///
   /// Low level barrier not meant to be called explictly
@@ -60,6 +235,13 @@ namespace SUNphi
 	MINIMAL_CRASH_STDLIBERR("while barrier was destroyed");
     }
     
+    /// Changes the number of threads, when no thread is waiting
+    void resize(const int& nNewThreads) ///< New number of threads
+    {
+      if(pthread_barrier_destroy(&barrier)!=0 or pthread_barrier_init(&barrier,nullptr,nNewThreads)!=0)
+	MINIMAL_CRASH_STDLIBERR("while barrier was resized");
+    }
+    
     /// Synchronize, without checking the name of the barrier
     void sync()
     {
@@ -88,6 +270,7 @@ namespace SUNphi
     }
   };
   
+#endif
 #else
   
   /// Fake barrier
@@ -98,6 +281,11 @@ namespace SUNphi
     {
     }
     
+    /// Dummy change of the number of threads
+    void resize(const int& nNewThreads) ///< New number of threads
+    {
+    }
+    
     /// Dummy synchronize checking the name of the barrier
     void sync(const char* barrName=nullptr, ///< Name of the barrier
 	      const int& threadId=0)        ///< Id of the thread used coming to check
@@ -85,6 +85,10 @@ namespace SUNphi
   /// Dummy scope mutex locker
   struct ScopeMutexLocker
   {
+    /// Dummy create
+    ScopeMutexLocker(Mutex& mutex) ///< Mutex to be kept locked
+    {
+    }
   };
 
 #endif
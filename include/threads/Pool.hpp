@@ -16,18 +16,63 @@
  #include "config.hpp"
 #endif
 
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
+
 #include <external/inplace_function.h>
 
 #include <Tuple.hpp>
 #include <containers/Vector.hpp>
 #include <debug/MinimalCrash.hpp>
 #include <ios/MinimalLogger.hpp>
+#include <threads/Affinity.hpp>
 #include <threads/Barrier.hpp>
 #include <threads/Mutex.hpp>
 #include <threads/Thread.hpp>
 
 namespace SUNphi
 {
+  /// Scheduling policy of a loop split among the threads
+  enum class LoopScheduling{STATIC,DYNAMIC,GUIDED};
+  
+  /// Range of a loop assigned to a thread
+  template <typename Size>   // Type for the range of the loop
+  struct LoopChunk
+  {
+    /// Beginning of the chunk
+    Size beg;
+    
+    /// End of the chunk
+    Size end;
+  };
+  
+  /// Chunk of the loop [beg,end) assigned to a thread by the static partition
+  ///
+  /// The range is cut into \c nPieces contiguous chunks of equal
+  /// length, the last one possibly shorter
+  template <typename Size>   // Type for the range of the loop
+  LoopChunk<Size> staticLoopChunk(const Size& beg,      ///< Beginning of the loop
+				  const Size& end,      ///< End of the loop
+				  const int& nPieces,   ///< Number of chunks
+				  const int& threadId)  ///< Thread of which to get the chunk
+  {
+    /// Workload for each thread, taking into account the remainder
+    const Size threadLoad=
+      (end-beg+nPieces-1)/nPieces;
+    
+    /// Beginning of the chunk
+    const Size threadBeg=
+      std::min(end,beg+threadLoad*threadId);
+    
+    /// End of the chunk
+    const Size threadEnd=
+      std::min(end,threadBeg+threadLoad);
+    
+    return
+      {threadBeg,threadEnd};
+  }
+  
 #ifdef USE_THREADS
   
   /// Contains a thread pool
@@ -56,6 +101,15 @@ namespace SUNphi
     /// integer as an argument, corresponding to the thread
     Work work;
     
+    /// First thread executing the work
+    int workBegThreadId{masterThreadId};
+    
+    /// Thread following the last one executing the work
+    int workEndThreadId{0};
+    
+    /// Number of workers which have not yet completed the work
+    std::atomic<int> nPendingWorkers{0};
+    
     /// Incapsulate the threads
     ///
     /// At the beginning, the pool contains only the main thread, with
@@ -65,6 +119,14 @@ namespace SUNphi
     /// why we define the next function
     Vector<pthread_t> pool;
     
+    /// Id given to threads not belonging to the pool
+    static constexpr int notInPoolThreadId=
+      -1;
+    
+    /// Id of the current thread in the pool
+    static inline thread_local int currentThreadId=
+      notInPoolThreadId;
+    
     /// Return the thread tag
     static pthread_t getThreadTag()
     {
@@ -80,6 +142,18 @@ namespace SUNphi
     /// Barrier used by the threads
     Barrier barrier;
     
+    /// Policy used to pin the threads
+    const ThreadPinning pinning;
+    
+    /// Core to which each thread is pinned, -1 if not pinned
+    Vector<int> threadCore;
+    
+    /// NUMA node of the core to which each thread is pinned
+    Vector<int> threadNumaNode;
+    
+    /// Number of different NUMA nodes on which the threads are pinned
+    int nNumaNodesSpanned{1};
+    
     /// Pair of parameters containing the threadpool and the thread id
     using ThreadPars=
       Tuple<ThreadPool*,int>;
@@ -113,6 +187,12 @@ namespace SUNphi
       
       delete ptr;
       
+      currentThreadId=
+	threadId;
+      
+      // Pins the thread before anything is touched
+      pinCurrentThreadToCore(pool.threadCore[threadId]);
+      
       //runLog<<"entering the pool";
       
       /// Work until asked to empty
@@ -132,7 +212,12 @@ namespace SUNphi
 	  
 	  if(keepSwimming)
 	    {
-	      pool.work(threadId);
+	      if(threadId>=pool.workBegThreadId and threadId<pool.workEndThreadId)
+		{
+		  pool.work(threadId);
+		  
+		  pool.nPendingWorkers.fetch_sub(1,std::memory_order_release);
+		}
 	      
 	      pool.tellTheMasterWorkIsFinished(threadId);
 	    }
@@ -203,28 +288,42 @@ namespace SUNphi
     }
     
     /// Get the thread of the current thread
+    ///
+    /// The id is read from the thread-local storage, set when the
+    /// thread enters the pool. It is checked only in debug mode.
     int getThreadId()
       const
     {
-      /// Current pthread
-      const pthread_t threadTag=
-	getThreadTag();
+#ifdef DEBUG_MODE
       
-      /// Position in the pool
-      int threadId=
-	pool.findFirst(threadTag);
+      if(currentThreadId==notInPoolThreadId)
+	MINIMAL_CRASH("Unable to find thread with tag %d in the pool",getThreadTag());
       
-      // Check that the thread is found
-      if(threadId==nActiveThreads())
-	{
-	  fprintf(stdout,"%d %d\n",threadId,nActiveThreads());
-	  for(auto & p : pool)
-	    fprintf(stdout,"%d\n",(int)p);
-	  MINIMAL_CRASH("Unable to find thread with tag %d",threadTag);
-	}
+#endif
       
       return
-	threadId;
+	currentThreadId;
+    }
+    
+    /// Changes the number of threads in the pool
+    ///
+    /// All workers are joined and new ones are created. The master
+    /// keeps the id \c masterThreadId, and the id of each worker is
+    /// set afresh at entry in the pool, so that \c getThreadId is
+    /// always valid and in the range [0,nActiveThreads). Must be called
+    /// by the master thread, outside any parallel region.
+    void resize(const int& nNewThreads) ///< New number of threads
+    {
+      assertMasterOnly(getThreadId());
+      
+      empty();
+      
+      nThreads=
+	nNewThreads;
+      
+      barrier.resize(nThreads);
+      
+      fill();
     }
     
     
@@ -267,6 +366,38 @@ namespace SUNphi
 	pool.size();
     }
     
+    /// Gets the policy used to pin the threads
+    ThreadPinning getPinning()
+      const
+    {
+      return
+	pinning;
+    }
+    
+    /// Core to which the thread is pinned, -1 if not pinned
+    int coreOfThread(const int& threadId) ///< Thread of which to get the core
+      const
+    {
+      return
+	threadCore[threadId];
+    }
+    
+    /// NUMA node on which the thread runs, 0 if not pinned
+    int numaNodeOfThread(const int& threadId) ///< Thread of which to get the node
+      const
+    {
+      return
+	threadNumaNode[threadId];
+    }
+    
+    /// Number of different NUMA nodes on which the threads are pinned
+    int nNumaNodes()
+      const
+    {
+      return
+	nNumaNodesSpanned;
+    }
+    
     /// Tag to mark that assignment has been finished
     static constexpr char workAssignmentTag[]=
       "WorkAssOrNoMoreWork";
@@ -407,6 +538,15 @@ namespace SUNphi
       work=
 	f;
       
+      workBegThreadId=
+	masterThreadId;
+      
+      workEndThreadId=
+	nThreads;
+      
+      nPendingWorkers=
+	nThreads-1;
+      
       // Set off the other threads
       tellThePoolWorkIsAssigned(masterThreadId);
       
@@ -416,38 +556,303 @@ namespace SUNphi
       waitForPoolToFinishAssignedWork(masterThreadId);
     }
     
-    /// Split a loop into \c nTrheads chunks, giving each chunk as a work for a corresponding thread
-    template <typename Size,           // Type for the range of the loop
-	      typename F>              // Type for the work function
-    void loopSplit(const Size& beg,  ///< Beginning of the loop
-		   const Size& end,  ///< End of the loop
-		   F f)              ///< Function to be called, accepting two integers: the first is the thread id, the second the loop argument
+    /// Handle to a work given asynchronously to the pool
+    ///
+    /// The work is completed when \c wait is called, or when the handle
+    /// is destroyed. Until then no other work can be given to the pool.
+    class AsyncWork
+    {
+      /// Pool executing the work
+      ThreadPool* pool;
+      
+      /// Mark whether the master has still to synchronize with the pool
+      bool toBeWaited;
+      
+    public:
+      
+      /// Check whether all the threads have completed the work
+      bool isReady()
+	const
+      {
+	return
+	  (not toBeWaited) or pool->nPendingWorkers.load(std::memory_order_acquire)==0;
+      }
+      
+      /// Waits that all the threads complete the work
+      void wait()
+      {
+	if(toBeWaited)
+	  pool->waitForPoolToFinishAssignedWork(masterThreadId);
+	
+	toBeWaited=
+	  false;
+      }
+      
+      /// Creates the handle
+      AsyncWork(ThreadPool* pool,         ///< Pool executing the work
+		const bool& toBeWaited)   ///< Mark whether the master must synchronize with the pool
+	: pool(pool),
+	  toBeWaited(toBeWaited)
+      {
+      }
+      
+      /// Move constructor, taking over the duty to wait
+      AsyncWork(AsyncWork&& oth)
+	: pool(oth.pool),
+	  toBeWaited(oth.toBeWaited)
+      {
+	oth.toBeWaited=
+	  false;
+      }
+      
+      /// Forbids copying the handle
+      AsyncWork(const AsyncWork&)=delete;
+      
+      /// Waits the work at destruction
+      ~AsyncWork()
+      {
+	wait();
+      }
+    };
+    
+    /// Gives some work to the threads in the range [begThreadId,endThreadId), without waiting for it
+    ///
+    /// The master thread does not participate, and can keep on
+    /// working, for example communicating with other ranks, while the
+    /// workers compute. The returned handle must be waited before
+    /// any other work is given to the pool. If the pool has no worker,
+    /// the work is executed by the master before returning.
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// ThreadPool::AsyncWork handle=
+    ///   threads.workOnAsync([](const int threadId){computeBulk(threadId);});
+    ///
+    /// communicateBorders();
+    ///
+    /// handle.wait();
+    /// \endcode
+    template <typename F>
+    AsyncWork workOnAsync(F f,                      ///< Function embedding the work
+			  const int& begThreadId=1, ///< First thread executing the work
+			  int endThreadId=0)        ///< Thread following the last one executing the work, all threads if zero
+    {
+      // Check that the pool is waiting for work
+      if(not isWaitingForWork)
+	MINIMAL_CRASH("Trying to give work to not-waiting pool!");
+      
+      if(nThreads==1)
+	{
+	  f(masterThreadId);
+	  
+	  return
+	    {this,false};
+	}
+      
+      if(endThreadId==0)
+	endThreadId=
+	  nThreads;
+      
+      if(begThreadId<=masterThreadId or begThreadId>=endThreadId or endThreadId>nThreads)
+	MINIMAL_CRASH("Range of threads [%d,%d) not valid for an asynchronous work on a pool of %d threads",begThreadId,endThreadId,nThreads);
+      
+      // Store the work
+      work=
+	f;
+      
+      workBegThreadId=
+	begThreadId;
+      
+      workEndThreadId=
+	endThreadId;
+      
+      nPendingWorkers=
+	endThreadId-begThreadId;
+      
+      // Set off the other threads
+      tellThePoolWorkIsAssigned(masterThreadId);
+      
+      return
+	{this,true};
+    }
+    
+    /// Gives some work to a single worker, without waiting for it
+    template <typename F>
+    AsyncWork workOnThreadAsync(F f,                 ///< Function embedding the work
+				const int& threadId) ///< Thread executing the work
+    {
+      return
+	workOnAsync(f,threadId,threadId+1);
+    }
+    
+    /// Split a loop into chunks, giving each chunk as a work for a thread
+    ///
+    /// The chunks are assigned to the threads according to the
+    /// scheduling policy \c Sched:
+    ///
+    /// - \c STATIC: if \c chunkSize is zero, the range is cut into \c
+    ///   nActiveThreads contiguous chunks of equal length, otherwise
+    ///   chunks of \c chunkSize elements are assigned round-robin;
+    /// - \c DYNAMIC: chunks of \c chunkSize elements (one if zero) are
+    ///   taken by each thread from a shared atomic counter, as soon as
+    ///   the previous one is completed;
+    /// - \c GUIDED: as \c DYNAMIC, but the length of each chunk is
+    ///   proportional to the number of elements still to be assigned
+    ///   divided by the number of threads, and never smaller than \c
+    ///   chunkSize.
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// threads.loopSplit<LoopScheduling::DYNAMIC>(0,vol,[](const int& threadId,const int& iSite){...},16);
+    /// \endcode
+    template <LoopScheduling Sched=LoopScheduling::STATIC, // Scheduling policy
+	      typename Size,                                // Type for the range of the loop
+	      typename F>                                   // Type for the work function
+    void loopSplit(const Size& beg,                               ///< Beginning of the loop
+		   const Size& end,                               ///< End of the loop
+		   F f,                                           ///< Function to be called, accepting two integers: the first is the thread id, the second the loop argument
+		   const std::common_type_t<Size>& chunkSize=0)   ///< Size of the chunks, not used to deduce \c Size
     {
-      workOn([beg,end,nPieces=this->nActiveThreads(),&f](const int& threadId)
+      /// Beginning of the next chunk to be assigned, when dynamically scheduled
+      std::atomic<Size> nextChunkBeg{beg};
+      
+      workOn([beg,end,chunkSize,nPieces=this->nActiveThreads(),&nextChunkBeg,&f](const int& threadId)
 	     {
-	       /// Workload for each thread, taking into account the remainder
-	       const Size threadLoad=
-		 (end-beg+nPieces-1)/nPieces;
-	       
-	       /// Beginning of the chunk
-	       const Size threadBeg=
-		 threadLoad*threadId;
-	       
-	       /// End of the chunk
-	       const Size threadEnd=
-		 std::min(end,threadBeg+threadLoad);
+	       /// Executes the loop over a chunk
+	       auto loopOnChunk=
+		 [threadId,&f](const Size& chunkBeg,
+			       const Size& chunkEnd)
+		 {
+		   for(Size i=chunkBeg;i<chunkEnd;i++)
+		     f(threadId,i);
+		 };
 	       
-	       for(Size i=threadBeg;i<threadEnd;i++)
-		 f(threadId,i);
+	       if constexpr(Sched==LoopScheduling::STATIC)
+		 {
+		   if(chunkSize==0)
+		     {
+		       /// Chunk of the thread
+		       const LoopChunk<Size> chunk=
+			 staticLoopChunk(beg,end,nPieces,threadId);
+		       
+		       loopOnChunk(chunk.beg,chunk.end);
+		     }
+		   else
+		     for(Size chunkBeg=beg+chunkSize*threadId;chunkBeg<end;chunkBeg+=chunkSize*nPieces)
+		       loopOnChunk(chunkBeg,std::min(end,chunkBeg+chunkSize));
+		 }
+	       else
+		 {
+		   /// Minimal size of the chunks
+		   const Size minChunkSize=
+		     std::max(chunkSize,Size{1});
+		   
+		   /// Beginning of the chunk
+		   Size chunkBeg=
+		     nextChunkBeg.load(std::memory_order_relaxed);
+		   
+		   while(chunkBeg<end)
+		     {
+		       /// Size of the chunk
+		       Size chunkLength=
+			 minChunkSize;
+		       
+		       if constexpr(Sched==LoopScheduling::GUIDED)
+			 chunkLength=
+			   std::max(minChunkSize,(end-chunkBeg)/nPieces);
+		       
+		       /// End of the chunk
+		       const Size chunkEnd=
+			 std::min(end,chunkBeg+chunkLength);
+		       
+		       // Takes the chunk if nobody else took it in the meanwhile, otherwise retry from the updated beginning
+		       if(nextChunkBeg.compare_exchange_weak(chunkBeg,chunkEnd,std::memory_order_relaxed))
+			 {
+			   loopOnChunk(chunkBeg,chunkEnd);
+			   
+			   chunkBeg=
+			     nextChunkBeg.load(std::memory_order_relaxed);
+			 }
+		     }
+		 }
 	     });
     }
     
+    /// Reduces a loop split among the threads
+    ///
+    /// Each thread accumulates the values returned by \c f in its own
+    /// partial result, initialized with \c identity and kept on a
+    /// separate cache line to avoid false sharing. The partial results
+    /// are then combined by the master thread in order of thread id,
+    /// so that with \c STATIC scheduling the result is reproducible
+    /// for a given number of threads.
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// const double norm2=
+    ///   threads.loopSplitReduce(0,vol,0.0,[&v](const int& threadId,const int& iSite){return v[iSite]*v[iSite];},std::plus<double>());
+    /// \endcode
+    template <LoopScheduling Sched=LoopScheduling::STATIC, // Scheduling policy
+	      typename Size,                                // Type for the range of the loop
+	      typename T,                                   // Type of the result
+	      typename F,                                   // Type for the work function
+	      typename C>                                   // Type of the combiner
+    T loopSplitReduce(const Size& beg,                               ///< Beginning of the loop
+		      const Size& end,                               ///< End of the loop
+		      const T& identity,                             ///< Identity of the reduction
+		      F f,                                           ///< Function to be called, accepting the thread id and the loop argument, returning the value to be reduced
+		      C combine,                                     ///< Combiner of two values, returning the result
+		      const std::common_type_t<Size>& chunkSize=0)   ///< Size of the chunks, not used to deduce \c Size
+    {
+      /// Partial result of a thread, padded to fill whole cache lines
+      struct alignas(CACHE_LINE_SIZE) Partial
+      {
+	/// Accumulated value
+	T value;
+      };
+      
+      /// Partial results of all threads
+      Vector<Partial> partials(this->nActiveThreads(),Partial{identity});
+      
+      loopSplit<Sched>(beg,end,[&partials,&f,&combine](const int& threadId,const Size& i)
+			       {
+				 /// Partial result of the thread
+				 T& partial=
+				   partials[threadId].value;
+				 
+				 partial=
+				   combine(partial,f(threadId,i));
+			       },chunkSize);
+      
+      /// Result
+      T res=
+	identity;
+      
+      for(const Partial& partial : partials)
+	res=
+	  combine(res,partial.value);
+      
+      return
+	res;
+    }
+    
     /// Constructor starting the thread pool with a given number of threads
-    ThreadPool(int nThreads=std::thread::hardware_concurrency()) :
+    ///
+    /// The pinning policy is by default read from the environment, see
+    /// \c Affinity.hpp
+    ThreadPool(int nThreads=std::thread::hardware_concurrency(),          ///< Number of threads
+	       const ThreadPinning& pinning=getThreadPinningFromEnv()) :  ///< Pinning policy
       pool(1,getThreadTag()),
       nThreads(nThreads),
-      barrier(nThreads)
+      barrier(nThreads),
+      pinning(pinning)
     {
+      currentThreadId=
+	masterThreadId;
+      
       fill();
     }
     
@@ -487,6 +892,11 @@ namespace SUNphi
 	0;
     }
     
+    /// Dummy change of the number of threads
+    void resize(const int& nNewThreads) ///< New number of threads
+    {
+    }
+    
     /// Lock the internal mutex
     void mutexLock()
     {
@@ -532,19 +942,121 @@ namespace SUNphi
       f(0);
     }
     
+    /// Dummy handle to a work given asynchronously
+    struct AsyncWork
+    {
+      /// The work is always completed
+      bool isReady()
+	const
+      {
+	return
+	  true;
+      }
+      
+      /// Nothing to be waited
+      void wait()
+      {
+      }
+    };
+    
+    /// Executes the work immediately
+    template <typename F>
+    AsyncWork workOnAsync(F f,                      ///< Function embedding the work
+			  const int& begThreadId=1, ///< First thread executing the work
+			  int endThreadId=0)        ///< Thread following the last one executing the work
+    {
+      f(0);
+      
+      return
+	{};
+    }
+    
+    /// Executes the work immediately
+    template <typename F>
+    AsyncWork workOnThreadAsync(F f,                 ///< Function embedding the work
+				const int& threadId) ///< Thread executing the work
+    {
+      return
+	workOnAsync(f,threadId,threadId+1);
+    }
+    
     /// Perform a loop
-    template <typename Size,           // Type for the range of the loop
-	      typename F>              // Type for the work function
-    void loopSplit(const Size& beg,  ///< Beginning of the loop
-		   const Size& end,  ///< End of the loop
-		   F f)              ///< Function to be called, accepting two integers: the first is the thread id, which will always be 0, the second the loop argument
+    ///
+    /// The scheduling policy and the chunk size are ignored
+    template <LoopScheduling Sched=LoopScheduling::STATIC, // Scheduling policy
+	      typename Size,                                // Type for the range of the loop
+	      typename F>                                   // Type for the work function
+    void loopSplit(const Size& beg,                               ///< Beginning of the loop
+		   const Size& end,                               ///< End of the loop
+		   F f,                                           ///< Function to be called, accepting two integers: the first is the thread id, which will always be 0, the second the loop argument
+		   const std::common_type_t<Size>& chunkSize=0)   ///< Size of the chunks, not used to deduce \c Size
     {
       for(Size i=beg;i<end;i++)
 	f(0,i);
     }
     
+    /// Reduces a loop
+    ///
+    /// The scheduling policy and the chunk size are ignored
+    template <LoopScheduling Sched=LoopScheduling::STATIC, // Scheduling policy
+	      typename Size,                                // Type for the range of the loop
+	      typename T,                                   // Type of the result
+	      typename F,                                   // Type for the work function
+	      typename C>                                   // Type of the combiner
+    T loopSplitReduce(const Size& beg,                               ///< Beginning of the loop
+		      const Size& end,                               ///< End of the loop
+		      const T& identity,                             ///< Identity of the reduction
+		      F f,                                           ///< Function to be called, accepting the thread id, which will always be 0, and the loop argument, returning the value to be reduced
+		      C combine,                                     ///< Combiner of two values, returning the result
+		      const std::common_type_t<Size>& chunkSize=0)   ///< Size of the chunks, not used to deduce \c Size
+    {
+      /// Result
+      T res=
+	identity;
+      
+      for(Size i=beg;i<end;i++)
+	res=
+	  combine(res,f(0,i));
+      
+      return
+	res;
+    }
+    
+    /// Gets the policy used to pin the threads, which is always none
+    ThreadPinning getPinning()
+      const
+    {
+      return
+	ThreadPinning::NONE;
+    }
+    
+    /// Core to which the thread is pinned, always -1
+    int coreOfThread(const int& threadId) ///< Thread of which to get the core
+      const
+    {
+      return
+	-1;
+    }
+    
+    /// NUMA node on which the thread runs, always 0
+    int numaNodeOfThread(const int& threadId) ///< Thread of which to get the node
+      const
+    {
+      return
+	0;
+    }
+    
+    /// Number of different NUMA nodes on which the threads are pinned, always 1
+    int nNumaNodes()
+      const
+    {
+      return
+	1;
+    }
+    
     /// Dummy constructor
-    ThreadPool(int nThreads=1)
+    ThreadPool(int nThreads=1,                                 ///< Number of threads
+	       const ThreadPinning& pinning=ThreadPinning::NONE) ///< Pinning policy
     {
     }
   };
@@ -0,0 +1,338 @@
+#ifndef _TASKSCHEDULER_HPP
+#define _TASKSCHEDULER_HPP
+
+/// \file TaskScheduler.hpp
+///
+/// \brief Provides a work-stealing task scheduler on top of the thread pool
+///
+/// The \c ThreadPool can only broadcast the same closure to all
+/// threads, so irregular workloads stall on the slowest thread. The
+/// scheduler defined here runs inside a single \c workOn call: each
+/// thread owns a deque of tasks, pushing and popping at the back,
+/// while idle threads steal from the front of the deques of the other
+/// threads.
+///
+/// Tasks are spawned inside a \c TaskGroup, which can be waited
+/// for. While waiting, a thread keeps executing other tasks, so
+/// that nested spawning is allowed:
+///
+/// \code
+/// TaskScheduler scheduler;
+///
+/// scheduler.run([&](const int threadId)
+///               {
+///                 TaskGroup group;
+///
+///                 for(int iBlock=0;iBlock<nBlocks;iBlock++)
+///                   scheduler.spawn(group,threadId,[iBlock](const int threadId)
+///                                                  {
+///                                                    updateBlock(iBlock);
+///                                                  });
+///
+///                 scheduler.sync(group,threadId);
+///               });
+/// \endcode
+///
+/// The simpler case of a set of independent tasks, one per element
+/// of a range, is covered by \c runTasks.
+
+#ifdef HAVE_CONFIG_H
+ #include "config.hpp"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+
+#include <external/inplace_function.h>
+
+#include <containers/Vector.hpp>
+#include <threads/Mutex.hpp>
+#include <threads/Pool.hpp>
+#include <threads/Thread.hpp>
+
+namespace SUNphi
+{
+  /// Group of tasks which can be waited for
+  ///
+  /// The group only counts the tasks which have been spawned and not
+  /// yet completed, so it must outlive all the tasks spawned in it
+  class TaskGroup
+  {
+    /// Number of tasks spawned and not yet completed
+    std::atomic<int> nPending{0};
+    
+    friend class TaskScheduler;
+  
+  public:
+    
+    /// Check if all the tasks of the group have been completed
+    bool isCompleted()
+      const
+    {
+      return
+	nPending.load(std::memory_order_acquire)==0;
+    }
+  };
+  
+  /// Work-stealing scheduler running on the pool threads
+  class TaskScheduler
+  {
+    /// Maximal size of the stack used for the task
+    static constexpr int MAX_TASK_FUNCTION_SIZE=
+      128;
+    
+    /// Type to encapsulate the work of a single task
+    ///
+    /// The integer argument is the id of the thread executing the task
+    using Work=
+      stdext::inplace_function<void(int),MAX_TASK_FUNCTION_SIZE>;
+    
+    /// Single task, with the group to be notified at completion
+    struct Task
+    {
+      /// Work to be done
+      Work work;
+      
+      /// Group to which the task belongs
+      TaskGroup* group;
+    };
+    
+    /// Deque of tasks owned by a thread
+    ///
+    /// Aligned to the cache line to avoid false sharing between the
+    /// deques of different threads
+    struct alignas(CACHE_LINE_SIZE) TaskDeque
+    {
+      /// Mutex protecting the deque
+      Mutex mutex;
+      
+      /// List of tasks
+      std::deque<Task> tasks;
+    };
+    
+    /// Pool of threads used to execute the tasks
+    ThreadPool& pool;
+    
+    /// Deque of each thread
+    Vector<TaskDeque> deques;
+    
+    /// Number of tasks spawned and not yet completed, in all groups
+    std::atomic<int> nPendingTasks{0};
+    
+    /// Mark that the root work has been completed
+    std::atomic<bool> rootIsCompleted{false};
+    
+    /// Pops the most recently pushed task of the thread
+    bool popOwnTask(Task& task,            ///< Popped task
+		    const int& threadId)   ///< Thread popping
+    {
+      /// Deque of the thread
+      TaskDeque& deque=
+	deques[threadId];
+      
+      ScopeMutexLocker locker(deque.mutex);
+      
+      if(deque.tasks.empty())
+	return
+	  false;
+      
+      task=
+	std::move(deque.tasks.back());
+      
+      deque.tasks.pop_back();
+      
+      return
+	true;
+    }
+    
+    /// Steals the oldest task of some other thread
+    ///
+    /// The victims are scanned in a round-robin order starting from
+    /// the thread following the thief, to spread the thefts
+    bool stealTask(Task& task,            ///< Stolen task
+		   const int& threadId)   ///< Thread stealing
+    {
+      /// Number of deques
+      const int nDeques=
+	deques.size();
+      
+      for(int iVictim=1;iVictim<nDeques;iVictim++)
+	{
+	  /// Deque of the victim
+	  TaskDeque& deque=
+	    deques[(threadId+iVictim)%nDeques];
+	  
+	  ScopeMutexLocker locker(deque.mutex);
+	  
+	  if(not deque.tasks.empty())
+	    {
+	      task=
+		std::move(deque.tasks.front());
+	      
+	      deque.tasks.pop_front();
+	      
+	      return
+		true;
+	    }
+	}
+      
+      return
+	false;
+    }
+    
+    /// Executes a single task, either from the own deque or stealing it
+    ///
+    /// Returns whether a task has been found
+    bool runOneTask(const int& threadId)   ///< Thread executing
+    {
+      /// Task to be run
+      Task task;
+      
+      if(not (popOwnTask(task,threadId) or stealTask(task,threadId)))
+	return
+	  false;
+      
+      task.work(threadId);
+      
+      task.group->nPending.fetch_sub(1,std::memory_order_release);
+      nPendingTasks.fetch_sub(1,std::memory_order_release);
+      
+      return
+	true;
+    }
+    
+    /// Spawns the tasks of a range, splitting it recursively into halves
+    ///
+    /// The upper half is spawned as a new task, while the lower one
+    /// is further split by the current thread, so that thieves steal
+    /// large chunks of work
+    template <typename Size,           // Type for the range
+	      typename F>              // Type of the function
+    void spawnRange(TaskGroup& group,           ///< Group of the tasks
+		    const int& threadId,        ///< Thread spawning
+		    const Size& beg,            ///< Beginning of the range
+		    Size end,                   ///< End of the range
+		    const Size& grainSize,      ///< Minimal number of elements per task
+		    const F& f)                 ///< Function to be called on each element
+    {
+      while(end-beg>grainSize)
+	{
+	  /// Middle of the range
+	  const Size mid=
+	    beg+(end-beg)/2;
+	  
+	  spawn(group,threadId,[this,&group,mid,end,grainSize,&f](const int& threadId)
+			       {
+				 spawnRange(group,threadId,mid,end,grainSize,f);
+			       });
+	  
+	  end=
+	    mid;
+	}
+      
+      for(Size i=beg;i<end;i++)
+	f(threadId,i);
+    }
+  
+  public:
+    
+    /// Spawns a task inside a group
+    ///
+    /// The task is pushed in the deque of the spawning thread, and can
+    /// be stolen by any other thread. The callable must accept the id
+    /// of the executing thread.
+    template <typename F>
+    void spawn(TaskGroup& group,     ///< Group to which the task belongs
+	       const int& threadId,  ///< Thread spawning
+	       F&& f)                ///< Work of the task
+    {
+      group.nPending.fetch_add(1,std::memory_order_relaxed);
+      nPendingTasks.fetch_add(1,std::memory_order_relaxed);
+      
+      /// Deque of the thread
+      TaskDeque& deque=
+	deques[threadId];
+      
+      ScopeMutexLocker locker(deque.mutex);
+      
+      deque.tasks.push_back({Work(forw<F>(f)),&group});
+    }
+    
+    /// Waits that all tasks of a group are completed
+    ///
+    /// In the meanwhile the thread executes the pending tasks
+    void sync(TaskGroup& group,     ///< Group to wait for
+	      const int& threadId)  ///< Thread waiting
+    {
+      while(not group.isCompleted())
+	if(not runOneTask(threadId))
+	  std::this_thread::yield();
+    }
+    
+    /// Runs the root work, executing all tasks spawned by it
+    ///
+    /// The root work is executed by the master thread, while all other
+    /// threads of the pool steal tasks until the root work and all
+    /// the tasks spawned are completed. Must be called by the master
+    /// thread, outside any parallel region.
+    template <typename F>
+    void run(F&& root)   ///< Root work, accepting the thread id
+    {
+      // Adapts the number of deques to the pool
+      deques.resize(pool.nActiveThreads());
+      
+      rootIsCompleted=
+	false;
+      
+      pool.workOn([this,&root](const int threadId)
+		  {
+		    if(threadId==masterThreadId)
+		      {
+			root(threadId);
+			
+			// Executes the tasks not synchronized by the root
+			while(nPendingTasks.load(std::memory_order_acquire)>0)
+			  if(not runOneTask(threadId))
+			    std::this_thread::yield();
+			
+			rootIsCompleted.store(true,std::memory_order_release);
+		      }
+		    else
+		      while(not rootIsCompleted.load(std::memory_order_acquire))
+			if(not runOneTask(threadId))
+			  std::this_thread::yield();
+		  });
+    }
+    
+    /// Runs \c f on each element of the range [beg,end) as independent tasks
+    ///
+    /// Each task covers at least \c grainSize elements. The callable
+    /// must accept the id of the executing thread and the element.
+    template <typename Size,           // Type for the range of the loop
+	      typename F>              // Type for the work function
+    void runTasks(const Size& beg,            ///< Beginning of the range
+		  const Size& end,            ///< End of the range
+		  const F& f,                 ///< Function to be called on each element
+		  const Size& grainSize=1)    ///< Minimal number of elements per task
+    {
+      run([this,&beg,&end,&f,&grainSize](const int& threadId)
+	  {
+	    /// Group holding all the tasks of the range
+	    TaskGroup group;
+	    
+	    spawnRange(group,threadId,beg,end,std::max(grainSize,Size{1}),f);
+	    
+	    sync(group,threadId);
+	  });
+    }
+    
+    /// Creates the scheduler over a given pool
+    TaskScheduler(ThreadPool& pool=threads) ///< Pool to be used
+      : pool(pool)
+    {
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,235 @@
+#ifndef _TEAMS_HPP
+#define _TEAMS_HPP
+
+/// \file Teams.hpp
+///
+/// \brief Splits the thread pool into teams working concurrently
+///
+/// Each team is a contiguous range of threads of the pool, with its
+/// own barrier. The teams execute different closures at the same
+/// time, inside a single parallel region of the pool, and join when
+/// the region ends. A typical use is to overlap the communication,
+/// driven by the master alone, with the computation on the bulk:
+///
+/// \code
+/// ThreadTeams teams({1,threads.nActiveThreads()-1});
+///
+/// teams.workOn([](ThreadTeam& team,const int& teamThreadId)
+///              {
+///                communicateBorders();
+///              },
+///              [](ThreadTeam& team,const int& teamThreadId)
+///              {
+///                team.loopSplit(0,bulkVol,[](const int& threadId,const int& iSite){...},teamThreadId);
+///              });
+/// \endcode
+///
+/// Since the master thread belongs to the first team, MPI can be
+/// called from there even if it is not initialized as thread-safe.
+
+#ifdef HAVE_CONFIG_H
+ #include "config.hpp"
+#endif
+
+#include <deque>
+
+#include <containers/Vector.hpp>
+#include <debug/MinimalCrash.hpp>
+#include <threads/Barrier.hpp>
+#include <threads/Pool.hpp>
+
+namespace SUNphi
+{
+  /// Team of threads, part of the pool
+  class ThreadTeam
+  {
+    /// Id in the pool of the first thread of the team
+    const int begThreadId;
+    
+    /// Number of threads in the team
+    const int nThreads;
+    
+    /// Barrier used by the team
+    Barrier barrier;
+  
+  public:
+    
+    /// Tag used to synchronize the team
+    static constexpr char teamSyncTag[]=
+      "TeamSync";
+    
+    /// Id in the pool of the first thread of the team
+    int getBegThreadId()
+      const
+    {
+      return
+	begThreadId;
+    }
+    
+    /// Number of threads in the team
+    int nActiveThreads()
+      const
+    {
+      return
+	nThreads;
+    }
+    
+    /// Id in the pool of a thread of the team
+    int poolThreadId(const int& teamThreadId) ///< Id of the thread inside the team
+      const
+    {
+      return
+	begThreadId+teamThreadId;
+    }
+    
+    /// Synchronizes all threads of the team
+    void sync(const int& teamThreadId) ///< Id of the thread inside the team
+    {
+      barrier.sync(teamSyncTag,teamThreadId);
+    }
+    
+    /// Split a loop among the threads of the team
+    ///
+    /// Must be called by all threads of the team, which are
+    /// synchronized at the end. The range is cut statically in
+    /// contiguous chunks. The function is called with the id of the
+    /// thread in the pool, so that per-thread quantities of the pool
+    /// can be used.
+    template <typename Size,           // Type for the range of the loop
+	      typename F>              // Type for the work function
+    void loopSplit(const Size& beg,            ///< Beginning of the loop
+		   const Size& end,            ///< End of the loop
+		   F f,                        ///< Function to be called, accepting the thread id in the pool and the loop argument
+		   const int& teamThreadId)    ///< Id of the thread inside the team
+    {
+      /// Chunk of the thread
+      const LoopChunk<Size> chunk=
+	staticLoopChunk(beg,end,nThreads,teamThreadId);
+      
+      /// Id in the pool
+      const int threadId=
+	poolThreadId(teamThreadId);
+      
+      for(Size i=chunk.beg;i<chunk.end;i++)
+	f(threadId,i);
+      
+      sync(teamThreadId);
+    }
+    
+    /// Creates the team for the given range of threads of the pool
+    ThreadTeam(const int& begThreadId,  ///< Id in the pool of the first thread
+	       const int& nThreads)     ///< Number of threads
+      : begThreadId(begThreadId),
+	nThreads(nThreads),
+	barrier(nThreads)
+    {
+    }
+  };
+  
+  /// Partition of the pool in teams
+  class ThreadTeams
+  {
+    /// Pool of threads split in teams
+    ThreadPool& pool;
+    
+    /// List of teams
+    ///
+    /// Barriers cannot be moved, so a deque is used to avoid relocation
+    std::deque<ThreadTeam> teams;
+    
+    /// Team to which each thread of the pool belongs
+    Vector<int> teamOfThread;
+  
+  public:
+    
+    /// Number of teams
+    int nTeams()
+      const
+    {
+      return
+	teams.size();
+    }
+    
+    /// Returns a given team
+    ThreadTeam& operator[](const int& iTeam) ///< Team to get
+    {
+      return
+	teams[iTeam];
+    }
+    
+    /// Team to which a thread of the pool belongs
+    int teamOf(const int& threadId) ///< Id in the pool
+      const
+    {
+      return
+	teamOfThread[threadId];
+    }
+    
+    /// Executes a different closure on each team, concurrently
+    ///
+    /// The i-th closure is called by all the threads of the i-th team,
+    /// with the team and the id of the thread inside the team. The
+    /// call returns when all the teams have completed their work.
+    template <typename...F>
+    void workOn(F&&...f) ///< Work of each team
+    {
+      if(sizeof...(F)!=teams.size())
+	MINIMAL_CRASH("Number of works %d does not match the number of teams %d",(int)sizeof...(F),nTeams());
+      
+      pool.workOn([this,&f...](const int threadId)
+		  {
+		    /// Team of the thread
+		    const int iTeam=
+		      teamOfThread[threadId];
+		    
+		    /// Reference to the team
+		    ThreadTeam& team=
+		      teams[iTeam];
+		    
+		    /// Id of the thread inside the team
+		    const int teamThreadId=
+		      threadId-team.getBegThreadId();
+		    
+		    /// Index of the work to be checked
+		    int iWork=
+		      0;
+		    
+		    // Calls only the work of the team
+		    ((iWork++==iTeam and (f(team,teamThreadId),true)),...);
+		  });
+    }
+    
+    /// Splits the pool in teams of given sizes
+    ///
+    /// The sizes must be positive and sum up to the number of threads
+    /// of the pool. The teams are formed by consecutive threads, the
+    /// first one containing the master.
+    ThreadTeams(const Vector<int>& teamSizes,  ///< Number of threads of each team
+		ThreadPool& pool=threads)      ///< Pool to split
+      : pool(pool)
+    {
+      /// Id of the first thread of the next team
+      int begThreadId=
+	0;
+      
+      for(const int& teamSize : teamSizes)
+	{
+	  if(teamSize<=0)
+	    MINIMAL_CRASH("Team size must be positive, %d asked",teamSize);
+	  
+	  teams.emplace_back(begThreadId,teamSize);
+	  
+	  for(int teamThreadId=0;teamThreadId<teamSize;teamThreadId++)
+	    teamOfThread.push_back(teams.size()-1);
+	  
+	  begThreadId+=
+	    teamSize;
+	}
+      
+      if(begThreadId!=pool.nActiveThreads())
+	MINIMAL_CRASH("Teams contain %d threads, while the pool has %d",begThreadId,pool.nActiveThreads());
+    }
+  };
+}
+
+#endif
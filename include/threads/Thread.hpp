@@ -23,7 +23,12 @@ namespace SUNphi
   [[ maybe_unused ]]
   constexpr int masterThreadId=
     0;
-  
+
+  /// Size of the cache line, used to pad data accessed by different threads
+  [[ maybe_unused ]]
+  constexpr int CACHE_LINE_SIZE=
+    64;
+
   /// Makes all thread print for current scope
 #ifdef USE_THREADS
  #define ALLOWS_ALL_THREADS_TO_PRINT_FOR_THIS_SCOPE(LOGGER)		\
@@ -9,6 +9,7 @@
 /// The extreme value is host in the \c extr variable
 /// When the class is implicitly access
 
+#include <atomic>
 #include <limits>
 
 #include <metaprogramming/SwallowSemicolon.hpp>
@@ -129,6 +130,72 @@ namespace SUNphi
   template <typename T>
   using ValWithMax=
     ValWithExtreme<T,MAXIMUM>;
+  
+  /// Class to keep a value and its maximum, which can be updated concurrently by many threads
+  ///
+  /// Only increments and decrements are provided, the maximum being
+  /// updated with a compare-and-swap loop only when exceeded
+  template <typename T>
+  class AtomicValWithMax
+  {
+    /// Stored value
+    std::atomic<T> val;
+    
+    /// Maximal value
+    std::atomic<T> max;
+    
+  public:
+    
+    /// Retrurn maximal value
+    T extreme()
+      const
+    {
+      return
+	max.load(std::memory_order_relaxed);
+    }
+    
+    /// Implicit cast to value
+    operator T()
+      const
+    {
+      return
+	val.load(std::memory_order_relaxed);
+    }
+    
+    /// Increments the value, updating the maximum
+    AtomicValWithMax& operator+=(const T& oth)
+    {
+      /// Value after the increment
+      const T newVal=
+	val.fetch_add(oth,std::memory_order_relaxed)+oth;
+      
+      /// Maximum before the update
+      T oldMax=
+	max.load(std::memory_order_relaxed);
+      
+      while(newVal>oldMax and not max.compare_exchange_weak(oldMax,newVal,std::memory_order_relaxed))
+	;
+      
+      return
+	*this;
+    }
+    
+    /// Decrements the value
+    AtomicValWithMax& operator-=(const T& oth)
+    {
+      val.fetch_sub(oth,std::memory_order_relaxed);
+      
+      return
+	*this;
+    }
+    
+    /// Constructor
+    AtomicValWithMax(const T& init=0) :
+      val(init),
+      max(init)
+    {
+    }
+  };
 }
 
 #endif
@@ -6,6 +6,7 @@
 ///
 /// \brief Implements the parts of code which require dedicated compilation units
 
+#include <algorithm>
 #include <cstdarg>
 #include <cstdio>
 
@@ -19,6 +20,7 @@
 #include <random/TrueRandomGenerator.hpp>
 #include <system/Memory.hpp>
 #include <system/Mpi.hpp>
+#include <system/SIMD.hpp>
 #include <system/Timer.hpp>
 #include <utility/Aliver.hpp>
 #include <utility/SingleInstance.hpp>
@@ -80,6 +82,28 @@ namespace SUNphi
       // Resize the pool to contain all threads
       pool.resize(nThreads,0);
       
+      // Computes the placement of the threads
+      threadCore=
+	getThreadsCores(pinning,nThreads);
+      
+      /// NUMA node of each core
+      const Vector<int> numaNodeOfCore=
+	getNumaNodeOfCores();
+      
+      threadNumaNode.resize(nThreads);
+      for(int threadId=0;threadId<nThreads;threadId++)
+	threadNumaNode[threadId]=
+	  (threadCore[threadId]>=0)?numaNodeOfCore[threadCore[threadId]]:0;
+      
+      /// List of different NUMA nodes used
+      Vector<int> numaNodes(threadNumaNode);
+      std::sort(numaNodes.begin(),numaNodes.end());
+      
+      nNumaNodesSpanned=
+	std::unique(numaNodes.begin(),numaNodes.end())-numaNodes.begin();
+      
+      pinCurrentThreadToCore(threadCore[masterThreadId]);
+      
       // Marks the pool as filled, even if we are still filling it, this will keep the threads swimming
       isFilled=
 	true;
@@ -97,6 +121,16 @@ namespace SUNphi
 	}
       
       waitPoolToBeFilled(masterThreadId);
+      
+      runLog()<<"Pinning policy of the threads: "<<threadPinningName(pinning);
+      
+      if(pinning!=ThreadPinning::NONE)
+	{
+	  SCOPE_INDENT(runLog);
+	  
+	  for(int threadId=0;threadId<nThreads;threadId++)
+	    runLog()<<"Thread "<<threadId<<" pinned to core "<<threadCore[threadId]<<" on NUMA node "<<threadNumaNode[threadId];
+	}
     }
     
     // Marks the pool is waiting for job to be done
@@ -165,6 +199,13 @@ namespace SUNphi
       runLog()<<"Configured at "<<CONFIG_TIME<<" with flags: "<<CONFIG_FLAGS<<"";
     }
     
+    /// Prints the SIMD backend in use
+    void printSIMDBackend()
+      const
+    {
+      runLog()<<"Using SIMD backend: "<<simdBackendName(simdBackend)<<", compiled for: "<<simdBackendName(COMPILE_TIME_SIMD_BACKEND);
+    }
+    
     /// Says bye bye
     void printBailout()
       const
@@ -181,6 +222,7 @@ namespace SUNphi
       printVersionContacts();
       printGitInfo();
       printConfigurePars();
+      printSIMDBackend();
       
       threads.workOn([](const int threadID){runLog()<<"ANNA";});
       
@@ -217,6 +259,10 @@ namespace SUNphi
   /// Global true random generator
   TrueRandomGenerator trueRandomGenerator;
   
+  /// SIMD backend chosen at runtime
+  const SIMDBackend simdBackend=
+    detectSIMDBackend();
+  
   /// Memory manager
   Memory memory;
   